@@ -0,0 +1,173 @@
+#include "allocstats.h"
+
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+
+//every form of new and delete is replaced here in one translation unit of its own, so the
+//compiler never sees a malloc from one of them paired with a free from another
+
+std::atomic<unsigned long> allocationCount(0);
+std::atomic<unsigned long> allocationBytes(0);
+thread_local unsigned long threadAllocationCount = 0;
+thread_local unsigned long threadAllocationBytes = 0;
+
+void* countedAlloc(size_t size, size_t alignment);
+
+void* countedAlloc(size_t size, size_t alignment)
+{
+    allocationCount++;
+    allocationBytes += size;
+    threadAllocationCount++;
+    threadAllocationBytes += size;
+
+    if(size == 0)
+    {
+        size = 1;
+
+    }
+
+    //aligned_alloc wants the size to be a multiple of the alignment
+    if(alignment > alignof(max_align_t))
+    {
+        return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+
+    }
+
+    return malloc(size);
+
+}
+
+void* operator new(size_t size)
+{
+    void* p = countedAlloc(size, 0);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+
+    }
+
+    return p;
+
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, 0);
+
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, 0);
+
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* p = countedAlloc(size, (size_t)alignment);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+
+    }
+
+    return p;
+
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, (size_t)alignment);
+
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size, (size_t)alignment);
+
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+    free(p);
+
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(p);
+
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(p);
+
+}
@@ -0,0 +1,15 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <atomic>
+
+//allocation counters for --stats and the benchmark. allocstats.cpp replaces the global
+//operator new and delete to keep them, so it is linked into the programs and not into libdova
+
+//every allocation in the process, and the ones made on the calling thread
+extern std::atomic<unsigned long> allocationCount;
+extern std::atomic<unsigned long> allocationBytes;
+extern thread_local unsigned long threadAllocationCount;
+extern thread_local unsigned long threadAllocationBytes;
+
+#endif
@@ -0,0 +1,510 @@
+#include "../dova.h"
+#include "../allocstats.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+//dovabench - generates a seeded random program and times libdova on it
+//every allocation in the process goes through the counters in allocstats.cpp
+
+typedef struct BenchOptions
+{
+    long lines;
+    unsigned int seed;
+
+    //chance of a line having a label, and of a branch/jump going forward
+    double labelDensity;
+    double forwardRatio;
+
+    int threads;
+    int repeat;
+
+    std::string jsonPath;
+    std::string emitPath;
+
+} BenchOptions;
+
+//one timed phase, the best of the repeats is kept
+typedef struct BenchResult
+{
+    std::string name;
+    double seconds;
+    long lines;
+    size_t bytes;
+    unsigned long allocations;
+    unsigned long allocatedBytes;
+    long peakRssKb;
+    bool ok;
+
+} BenchResult;
+
+BenchOptions makeBenchOptions();
+bool parseBenchOption(BenchOptions& options, const std::string& option);
+
+void generateProgram(const BenchOptions& options, std::string& out);
+std::string makeTemplate(std::string_view syntax);
+void writeOperand(std::mt19937& rng, const std::vector<long>& labelLines, long line, double forwardRatio, bool jump, std::string& out);
+
+BenchResult makeBenchResult(const std::string& name, long lines, size_t bytes);
+bool resetPeakRss();
+long peakRss();
+void writeJson(const BenchOptions& options, size_t sourceBytes, bool perPhaseRss, const std::vector<BenchResult>& results, std::ostream& out);
+
+int main(int argc, char** argv)
+{
+    BenchOptions options = makeBenchOptions();
+    for(int i = 1; i < argc; i++)
+    {
+        if(!parseBenchOption(options, argv[i]))
+        {
+            std::cout << "unknown option: " << argv[i] << "\n";
+            std::cout << "usage: ./dovabench [--lines=N] [--seed=S] [--labels=D] [--forward=F] [--threads=N] [--repeat=R] [--json=path] [--emit=path]\n";
+            return 1;
+
+        }
+
+    }
+
+    std::string source;
+    generateProgram(options, source);
+
+    //the generated program can be kept to feed the command line tool
+    if(options.emitPath.size() > 0)
+    {
+        std::ofstream emit(options.emitPath.c_str(), std::ios::out | std::ios::binary);
+        emit.write(source.data(), source.size());
+
+    }
+
+    std::vector<BenchResult> results;
+    std::vector<uint32_t> words;
+
+    //without a way to reset the high-water mark every phase reports the process peak so far
+    bool perPhaseRss = true;
+    std::string image;
+
+    for(int r = 0; r < options.repeat; r++)
+    {
+        //assemble the source into words
+        BenchResult assembleResult = makeBenchResult("assemble", options.lines, source.size());
+        {
+            unsigned long count = allocationCount;
+            unsigned long bytes = allocationBytes;
+            perPhaseRss = resetPeakRss() && perPhaseRss;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            AssembleResult assembled = assemble(source, options.threads);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            assembleResult.seconds = elapsed.count();
+            assembleResult.allocations = allocationCount - count;
+            assembleResult.allocatedBytes = allocationBytes - bytes;
+            assembleResult.peakRssKb = peakRss();
+            assembleResult.ok = assembled.ok;
+
+            for(unsigned int i = 0; i < assembled.diagnostics.size(); i++)
+            {
+                std::cerr << assembled.diagnostics[i];
+
+            }
+
+            words.swap(assembled.words);
+
+        }
+
+        //the disassembler input is the default text image the command line tool writes
+        image.clear();
+        formatWords(makeOutputFormat(), words.data(), words.size(), 0x00400000, image);
+
+        //read the image and disassemble it
+        BenchResult disassembleResult = makeBenchResult("disassemble", words.size(), image.size());
+        std::string text;
+        {
+            unsigned long count = allocationCount;
+            unsigned long bytes = allocationBytes;
+            perPhaseRss = resetPeakRss() && perPhaseRss;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            ImageReader reader = makeImageReader();
+            std::vector<uint32_t> read;
+            std::string error;
+            bool ok = readImage(reader, image.data(), image.size(), read, error) && finishImage(reader, error);
+
+            if(ok)
+            {
+                DisassembleResult result = disassemble(read, options.threads);
+                text.swap(result.text);
+                ok = result.ok;
+
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            disassembleResult.seconds = elapsed.count();
+            disassembleResult.allocations = allocationCount - count;
+            disassembleResult.allocatedBytes = allocationBytes - bytes;
+            disassembleResult.peakRssKb = peakRss();
+            disassembleResult.ok = ok && read.size() == words.size();
+
+        }
+
+        //assemble the disassembly again, the words have to come out the same
+        BenchResult roundTripResult = makeBenchResult("roundtrip", options.lines, source.size());
+        {
+            unsigned long count = allocationCount;
+            unsigned long bytes = allocationBytes;
+            perPhaseRss = resetPeakRss() && perPhaseRss;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            AssembleResult first = assemble(source, options.threads);
+            DisassembleResult middle = disassemble(first.words, options.threads);
+            AssembleResult second = assemble(middle.text, options.threads);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            roundTripResult.seconds = elapsed.count();
+            roundTripResult.allocations = allocationCount - count;
+            roundTripResult.allocatedBytes = allocationBytes - bytes;
+            roundTripResult.peakRssKb = peakRss();
+            roundTripResult.ok = first.ok && middle.ok && second.ok && first.words == second.words;
+
+        }
+
+        BenchResult runs[3] = { assembleResult, disassembleResult, roundTripResult };
+        for(int k = 0; k < 3; k++)
+        {
+            if(r == 0)
+                results.push_back(runs[k]);
+            else if(runs[k].seconds < results[k].seconds)
+                results[k] = runs[k];
+
+        }
+
+    }
+
+    if(options.jsonPath.size() > 0)
+    {
+        std::ofstream json(options.jsonPath.c_str());
+        writeJson(options, source.size(), perPhaseRss, results, json);
+
+    }
+    else
+    {
+        writeJson(options, source.size(), perPhaseRss, results, std::cout);
+
+    }
+
+    bool ok = true;
+    for(unsigned int i = 0; i < results.size(); i++)
+    {
+        if(!results[i].ok)
+        {
+            std::cerr << results[i].name << " failed\n";
+            ok = false;
+
+        }
+
+    }
+
+    return ok ? 0 : 1;
+
+}
+
+BenchOptions makeBenchOptions()
+{
+    BenchOptions options;
+    options.lines = 100000;
+    options.seed = 1;
+    options.labelDensity = 0.1;
+    options.forwardRatio = 0.5;
+    options.threads = 1;
+    options.repeat = 3;
+    return options;
+
+}
+
+bool parseBenchOption(BenchOptions& options, const std::string& option)
+{
+    size_t eq = option.find('=');
+    if(option.compare(0, 2, "--") != 0 || eq == std::string::npos)
+    {
+        return false;
+
+    }
+
+    std::string name = option.substr(2, eq - 2);
+    std::string value = option.substr(eq + 1);
+
+    if(name == "lines")
+        options.lines = atol(value.c_str());
+    else if(name == "seed")
+        options.seed = strtoul(value.c_str(), NULL, 10);
+    else if(name == "labels")
+        options.labelDensity = atof(value.c_str());
+    else if(name == "forward")
+        options.forwardRatio = atof(value.c_str());
+    else if(name == "threads")
+        options.threads = atoi(value.c_str());
+    else if(name == "repeat")
+        options.repeat = atoi(value.c_str());
+    else if(name == "json")
+        options.jsonPath = value;
+    else if(name == "emit")
+        options.emitPath = value;
+    else
+        return false;
+
+    options.lines = options.lines < 1 ? 1 : options.lines;
+    options.threads = options.threads < 1 ? 1 : options.threads;
+    options.repeat = options.repeat < 1 ? 1 : options.repeat;
+    return true;
+
+}
+
+void generateProgram(const BenchOptions& options, std::string& out)
+{
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    //pick the labelled lines first so branches can go forward to labels not written yet
+    std::vector<long> labelLines;
+    for(long line = 0; line < options.lines; line++)
+    {
+        if(chance(rng) < options.labelDensity)
+        {
+            labelLines.push_back(line);
+
+        }
+
+    }
+
+    //every instruction in the library's table, with its operands filled in below
+    std::vector<std::string> templates;
+    for(size_t i = 0; instructionSyntax(i).size() > 0; i++)
+    {
+        templates.push_back(makeTemplate(instructionSyntax(i)));
+
+    }
+    const size_t templateCount = templates.size();
+
+    out.reserve(options.lines * 24);
+
+    size_t nextLabel = 0;
+    for(long line = 0; line < options.lines; line++)
+    {
+        if(nextLabel < labelLines.size() && labelLines[nextLabel] == line)
+        {
+            out += "L";
+            out += std::to_string(nextLabel);
+            out += ": ";
+            nextLabel++;
+
+        }
+
+        for(const char* c = templates[rng() % templateCount].c_str(); *c != '\0'; c++)
+        {
+            switch(*c)
+            {
+                case 'R':
+                    out += registerName(rng() % 32);
+                    break;
+
+                case 'S':
+                    out += std::to_string(rng() % 32);
+                    break;
+
+                case 'I':
+                    out += std::to_string((int)(rng() % 65536) - 32768);
+                    break;
+
+                case 'O':
+                    out += std::to_string(((int)(rng() % 1024) - 512) * 4);
+                    break;
+
+                case 'B':
+                    writeOperand(rng, labelLines, line, options.forwardRatio, false, out);
+                    break;
+
+                case 'T':
+                    writeOperand(rng, labelLines, line, options.forwardRatio, true, out);
+                    break;
+
+                default:
+                    out += *c;
+                    break;
+
+            }
+
+        }
+
+        out += "\n";
+
+    }
+
+}
+
+std::string makeTemplate(std::string_view syntax)
+{
+    //registers become R and each kind of immediate its own letter: S shamt, I imm,
+    //O a byte offset in front of (, B a branch offset and T a jump target
+    std::string out;
+    size_t i = 0;
+    while(i < syntax.size())
+    {
+        size_t end = i;
+        while(end < syntax.size() && ((syntax[end] >= 'a' && syntax[end] <= 'z') || syntax[end] == '$'))
+        {
+            end++;
+
+        }
+
+        std::string_view word = syntax.substr(i, end - i);
+        if(word.empty())
+        {
+            out += syntax[i++];
+            continue;
+
+        }
+
+        if(i == 0)
+            out += word;
+        else if(word[0] == '$')
+            out += 'R';
+        else if(word == "shamt")
+            out += 'S';
+        else if(word == "imm")
+            out += 'I';
+        else if(word == "offset")
+            out += end < syntax.size() && syntax[end] == '(' ? 'O' : 'B';
+        else if(word == "target")
+            out += 'T';
+        else
+        {
+            std::cerr << "unknown operand " << word << " in " << syntax << "\n";
+            exit(1);
+
+        }
+
+        i = end;
+
+    }
+
+    return out;
+
+}
+
+void writeOperand(std::mt19937& rng, const std::vector<long>& labelLines, long line, double forwardRatio, bool jump, std::string& out)
+{
+    //labels after this line are [split, size), the rest are at or before it
+    size_t split = std::upper_bound(labelLines.begin(), labelLines.end(), line) - labelLines.begin();
+    bool forward = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < forwardRatio;
+
+    if(split == labelLines.size())
+        forward = false;
+    else if(split == 0)
+        forward = true;
+
+    if(labelLines.size() == 0)
+    {
+        //no labels at all, use a plain address in range
+        if(jump)
+            out += std::to_string(0x00400000 + (rng() % 1024) * 4);
+        else
+            out += std::to_string(((int)(rng() % 64) - 32) * 4);
+
+        return;
+
+    }
+
+    size_t label = forward ? split + rng() % (labelLines.size() - split) : rng() % split;
+    out += "L";
+    out += std::to_string(label);
+
+}
+
+BenchResult makeBenchResult(const std::string& name, long lines, size_t bytes)
+{
+    BenchResult result;
+    result.name = name;
+    result.seconds = 0.0;
+    result.lines = lines;
+    result.bytes = bytes;
+    result.allocations = 0;
+    result.allocatedBytes = 0;
+    result.peakRssKb = 0;
+    result.ok = false;
+    return result;
+
+}
+
+bool resetPeakRss()
+{
+    //5 resets the high-water mark in /proc/self/status to what is resident now (linux 4.0 and up)
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+    clear.flush();
+    return (bool)clear;
+
+}
+
+long peakRss()
+{
+    //kilobytes, the high-water mark since the last reset if there is one
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+    {
+        if(line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return atol(line.c_str() + 6);
+
+        }
+
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+
+}
+
+void writeJson(const BenchOptions& options, size_t sourceBytes, bool perPhaseRss, const std::vector<BenchResult>& results, std::ostream& out)
+{
+    out << "{\n";
+    out << "  \"lines\": " << options.lines << ",\n";
+    out << "  \"sourceBytes\": " << sourceBytes << ",\n";
+    out << "  \"seed\": " << options.seed << ",\n";
+    out << "  \"labelDensity\": " << options.labelDensity << ",\n";
+    out << "  \"forwardRatio\": " << options.forwardRatio << ",\n";
+    out << "  \"threads\": " << options.threads << ",\n";
+    out << "  \"repeat\": " << options.repeat << ",\n";
+    out << "  \"peakRssScope\": \"" << (perPhaseRss ? "phase" : "process") << "\",\n";
+    out << "  \"results\": [\n";
+
+    for(unsigned int i = 0; i < results.size(); i++)
+    {
+        const BenchResult& result = results[i];
+        double seconds = result.seconds > 0.0 ? result.seconds : 1e-9;
+
+        out << "    {\"name\": \"" << result.name << "\", \"ok\": " << (result.ok ? "true" : "false");
+        out << ", \"seconds\": " << result.seconds;
+        out << ", \"linesPerSecond\": " << (long)(result.lines / seconds);
+        out << ", \"mbPerSecond\": " << result.bytes / seconds / (1024.0 * 1024.0);
+        out << ", \"allocations\": " << result.allocations;
+        out << ", \"allocatedBytes\": " << result.allocatedBytes;
+        out << ", \"peakRssKb\": " << result.peakRssKb << "}";
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+
+}
@@ -3,4 +3,10 @@ cd "$(dirname "$0")"
 rm a.out
 rm b.asm
 rm b.out
+rm a.img
+rm c.asm
+rm c.out
+rm a.elf
+rm d.asm
+rm d.out
 rm diff.txt
@@ -1,998 +1,1568 @@
+#include "dova.h"
+#include "allocstats.h"
+
 #include <string>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <bitset>
-#include <iomanip>
-#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <deque>
 #include <algorithm>
-
-bool hexOutput = false;
-bool disassemble = false;
-bool binaryOutput = false;
-bool programCounter = false;
-
-int pc;
-
-std::string trim(std::string line);
-
-typedef struct Instruction
+#include <chrono>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+//the options and results of one assemble or disassemble run
+//all the real work happens in libdova so any number of jobs can run at once
+typedef struct Job
 {
-    typedef enum Type
-    {
-        R, I, J, Error
+    std::string inputPath;
+    std::string outputPath;
 
-    } Type;
+    OutputFormat format;
+    bool disassemble;
+    int threadCount;
 
-    std::string opname;
-    int opcode;
-    int funct;
-    Type type;
+    //--mmap sizes the output file up front and formats straight into a mapping of it
+    bool mapOutput;
 
-    typedef enum RegType
-    {
-        rs, rt, rd
-
-    } RegType;
+    //--stats prints a report to the log, --stats=<file> writes it as json
+    bool printStats;
+    std::string statsPath;
 
-    std::vector<RegType> regOrder;
+    //--cache=<file> keeps encoded regions between runs so only edited ones are assembled again
+    std::string cachePath;
 
-    typedef enum Flag
-    {
-        None, Jump, Offset
+    //-c writes an object module for --link instead of words
+    bool objectOutput;
 
-    } Flag;
+    //-l with -d puts labels on branch and jump targets, this needs the whole image in memory
+    bool labelOutput;
 
-    Flag flag;
+    //set by --link, the objects are linked in this order
+    std::vector<std::string> objectPaths;
 
-    int commaCount;
-    bool hasParens;
+    //--run stops the simulator after this many instructions, --steps=N changes it
+    unsigned long maxSteps;
 
-} Instruction;
+    //--fuzz runs this many cases (--cases=N) from this seed (--seed=S)
+    unsigned long fuzzCases;
+    uint64_t fuzzSeed;
 
-std::vector<Instruction> instructions;
+    //where errors and reports go
+    std::ostream* log;
 
-Instruction makeInstruction(std::string line, Instruction::Type type, int opcode);
-Instruction makeRType(std::string line, int opcode, int funct);
-Instruction makeIType(std::string line, int opcode, Instruction::Flag flag = Instruction::None);
-Instruction makeJType(std::string line, int opcode);
+    //filled in by runJob
+    bool ok;
+    long bytesRead;
+    long bytesWritten;
+    double seconds;
+    RunStats stats;
+    SymbolStats symbols;
 
-void initInstructions();
-Instruction getInstruction(std::string opname);
-Instruction getInstruction(std::bitset<32> bitInstr);
+} Job;
 
-std::bitset<5> pullRegister(std::bitset<32> bitInstr, int lower, int upper);
+Job makeJob();
+bool parseOption(Job& job, const std::string& option);
+bool runJob(Job& job);
 
-bool writeInstruction(Instruction instr, std::vector<int> regs, int num, std::ofstream& output);
-void writeInstruction(Instruction instr, std::bitset<32> bitInstr, std::ofstream& output);
+//where a job's output goes, text is gathered in one large buffer and written in few big calls
+//when the final size is known up front the file is sized and mapped and written in place instead
+typedef struct OutputSink
+{
+    int fd;
+    bool failed;
+    long written;
+
+    //callers can append here directly and then call flushSink
+    std::string buffer;
+
+    char* map;
+    size_t mapSize;
+
+    //false for stdout, which is never sized, mapped or truncated
+    bool isFile;
+
+} OutputSink;
+
+//the buffer is written out once it gets this big
+const size_t sinkBlockSize = 1024 * 1024;
+
+//outputs smaller than this are not worth a mapping
+const size_t sinkMapMinimum = 1024 * 1024;
+
+//words handed to the parallel disassembler at a time
+const size_t parallelBlockWords = 256 * 1024;
+
+//how much of the input is read at a time when streaming
+const size_t readChunkSize = 64 * 1024;
+
+OutputSink makeOutputSink();
+bool openSink(OutputSink& sink, const std::string& path);
+bool mapSink(OutputSink& sink, size_t size);
+void writeSink(OutputSink& sink, const char* data, size_t size);
+void flushSink(OutputSink& sink, bool force);
+bool closeSink(OutputSink& sink);
+void discardSink(OutputSink& sink);
+bool writeFully(int fd, struct iovec* parts, int count);
+
+//- is stdin for input and stdout for output
+std::istream* openInput(const std::string& path, std::ifstream& file);
+
+bool runAssembler(Job& job, std::istream& input, OutputSink& output);
+bool streamAssembler(Job& job, std::istream& input, OutputSink& output);
+bool runLinker(Job& job, OutputSink& output);
+bool runSimulator(Job& job);
+bool runVerifier(Job& job);
+bool runFuzzer(Job& job);
+bool readProgram(Job& job, std::istream& input, std::vector<uint32_t>& words, uint32_t& entry);
+void writeProgram(const Job& job, const AssembleResult& result, OutputSink& output);
+bool runDisassembler(Job& job, std::istream& input, OutputSink& output);
+void printStats(const Job& job);
+void writeStatsJson(const Job& job, std::ostream& out);
+long peakRss();
+void readWhole(std::istream& input, std::string& out);
+void readRegionCache(const std::string& path, RegionCache& cache);
+bool writeRegionCache(const std::string& path, const RegionCache& cache);
+
+//a worker's queue of job indices, idle workers steal from the front of the others
+typedef struct WorkQueue
+{
+    std::mutex lock;
+    std::deque<int> jobs;
 
-std::vector<std::string> nameToReg;
+} WorkQueue;
 
-void initRegs();
-int getRegNum(std::string reg);
-std::string getRegName(int num);
+int runBatch(const std::string& manifestPath, const Job& defaults, int workers);
+void runWorker(std::vector<WorkQueue>& queues, int self, std::vector<Job>& jobs);
 
-typedef struct Label
+int main(int argc, char** argv)
 {
-    std::string name;
-    int address;
-    bool last;
-
-} Label;
+    //checks the encoder against the decoder, the only mode without an input file
+    if(argc >= 2 && std::string(argv[1]) == "--fuzz")
+    {
+        Job job = makeJob();
+        job.threadCount = std::thread::hardware_concurrency();
+        for(int i = 2; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if(!parseOption(job, option))
+            {
+                std::cout << "unknown option: " << option << "\n";
+                return 0;
 
-Label makeLabel(std::string name);
+            }
 
-std::vector<Label> labels;
+        }
 
-Label getLabel(std::string name);
+        return runFuzzer(job) ? 0 : 1;
 
-void assembler(std::fstream& input, std::ofstream& output);
-void disassembler(std::fstream& input, std::ofstream& output);
+    }
 
-int main(int argc, char** argv)
-{
     if(argc < 3)
     {
-        std::cout << "usage: ./dova <inputfile> <outputfile> <options:-xdbp>\n";
+        std::cout << "usage: ./dova <inputfile> <outputfile> <options:-xdbprcel> [--big-endian] [--stats[=file.json]] [--threads=N] [--mmap] [--cache=file]\n";
+        std::cout << "       ./dova --batch <manifest> <options>\n";
+        std::cout << "       ./dova --link <outputfile> <objectfiles> <options>\n";
+        std::cout << "       ./dova --run <inputfile> [-d] [--steps=N] [--threads=N]\n";
+        std::cout << "       ./dova --verify <inputfile> [--threads=N]\n";
+        std::cout << "       ./dova --fuzz [--cases=N] [--seed=S] [--threads=N]\n";
         return 0;
 
     }
 
-    //get the command line parameters
-    std::string inputPath(argv[1]);
-    std::string outputPath(argv[2]);
-
-    for(unsigned int i = 3; i < argc; i++)
+    //runs the program in the simulator instead of writing anything
+    if(std::string(argv[1]) == "--run" || std::string(argv[1]) == "--verify")
     {
-        std::string option = argv[i];
-        if(option.find('x') != std::string::npos)
-            hexOutput = true;
-        
-        if(option.find('d') != std::string::npos)
-            disassemble = true;
-        
-        if(option.find('b') != std::string::npos)
-            binaryOutput = true;
-        
-        if(option.find('p') != std::string::npos)
-            programCounter = true;
+        Job job = makeJob();
+        job.inputPath = argv[2];
+        for(int i = 3; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if(!parseOption(job, option))
+            {
+                std::cout << "unknown option: " << option << "\n";
+                return 0;
+
+            }
+
+        }
+
+        if(std::string(argv[1]) == "--verify")
+        {
+            return runVerifier(job) ? 0 : 1;
+
+        }
+
+        return runSimulator(job) ? 0 : 1;
 
     }
 
-    //if no output type flag is set
-    if(!hexOutput && !binaryOutput)
+    //everything after the output file that is not an option is an object
+    if(std::string(argv[1]) == "--link")
     {
-        binaryOutput = true;
+        Job job = makeJob();
+        job.inputPath = "--link";
+        job.outputPath = argv[2];
+        for(int i = 3; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if(option[0] != '-')
+            {
+                job.objectPaths.push_back(option);
 
-    }
+            }
+            else if(!parseOption(job, option))
+            {
+                std::cout << "unknown option: " << option << "\n";
+                return 0;
 
-    //open the input file
-    std::fstream inputFile;
-    inputFile.open(inputPath.c_str());
+            }
 
-    if(!inputFile)
-    {
-        std::cout << "failed to open input file: " << inputPath << "\n";
-        return 0;
+        }
+
+        if(job.outputPath == "-")
+        {
+            job.log = &std::cerr;
+
+        }
+
+        return runJob(job) ? 0 : 1;
 
     }
 
-    //open the output file
-    std::ofstream outputFile;
-    outputFile.open(outputPath.c_str());
+    Job job = makeJob();
+    job.inputPath = argv[1];
+    job.outputPath = argv[2];
 
-    if(!outputFile)
+    //get the command line parameters
+    bool threadsSet = false;
+    for(int i = 3; i < argc; i++)
     {
-        std::cout << "failed to open output file: " << outputPath << "\n";
-        return 0;
+        std::string option = argv[i];
+        if(!parseOption(job, option))
+        {
+            std::cout << "unknown option: " << option << "\n";
+            return 0;
 
-    }
+        }
+
+        threadsSet = threadsSet || option.compare(0, 10, "--threads=") == 0;
 
-    initInstructions();
-    initRegs();
+    }
 
-    //TODO: call a function based on a command line switch -a assembler -d disassembler.
-    if(disassemble)
+    //in batch mode --threads sizes the pool instead, every file runs on one thread
+    if(job.inputPath == "--batch")
     {
-        disassembler(inputFile, outputFile);
+        int workers = threadsSet ? job.threadCount : std::thread::hardware_concurrency();
+        job.threadCount = 1;
+        return runBatch(job.outputPath, job, workers < 1 ? 1 : workers);
 
     }
-    else
+
+    //the output is the program so everything else goes to stderr
+    if(job.outputPath == "-")
     {
-        assembler(inputFile, outputFile);
+        job.log = &std::cerr;
 
     }
 
-    return 0;
+    return runJob(job) ? 0 : 1;
 
 }
 
-std::string trim(std::string line)
+Job makeJob()
 {
-    std::string whitespaces (" \t\f\v\n\r");
+    Job job;
+    job.format = makeOutputFormat();
+    job.format.binary = false;
+    job.disassemble = false;
+    job.printStats = false;
+    job.threadCount = 1;
+    job.mapOutput = false;
+    job.objectOutput = false;
+    job.labelOutput = false;
+    job.maxSteps = 1000000000;
+    job.fuzzCases = 10000000;
+    job.fuzzSeed = 1;
+    job.log = &std::cout;
+    job.ok = false;
+    job.bytesRead = 0;
+    job.bytesWritten = 0;
+    job.seconds = 0.0;
+    job.stats = makeRunStats();
+    job.symbols = SymbolStats();
+    return job;
 
-    //get positions of first and last non whitespace character
-    int posf = line.find_first_not_of(whitespaces);
+}
 
-    //trim off the whitespace
-    if(posf != std::string::npos)
-        line = line.substr(posf);
+bool parseOption(Job& job, const std::string& option)
+{
+    //long options are matched whole
+    if(option.compare(0, 2, "--") == 0)
+    {
+        if(option == "--big-endian")
+        {
+            job.format.bigEndian = true;
 
-    int posl = line.find_last_not_of(whitespaces);
+        }
+        else if(option == "--stats")
+        {
+            job.printStats = true;
 
-    if(posl != std::string::npos)
-        line = line.substr(0, posl+1);
+        }
+        else if(option.compare(0, 8, "--stats=") == 0)
+        {
+            job.statsPath = option.substr(8);
 
-    return line;
+        }
+        else if(option == "--mmap")
+        {
+            job.mapOutput = true;
 
-}
+        }
+        else if(option.compare(0, 8, "--cache=") == 0)
+        {
+            job.cachePath = option.substr(8);
 
-Instruction makeInstruction(std::string line, Instruction::Type type, int opcode)
-{
-    //parse the line similarly to the assembler
-    line = trim(line);
+        }
+        else if(option.compare(0, 8, "--steps=") == 0)
+        {
+            job.maxSteps = strtoul(option.substr(8).c_str(), NULL, 10);
 
-    //screw being careful here
-    std::string opname = line.substr(0, line.find(' '));
-    
-    std::vector<Instruction::RegType> regOrder;
+        }
+        else if(option.compare(0, 8, "--cases=") == 0)
+        {
+            job.fuzzCases = strtoul(option.substr(8).c_str(), NULL, 10);
 
-    while(line.find('$') != std::string::npos)
-    {
-        int pos = line.find('$');
-        std::string reg = line.substr(pos, 3); //get the reg name
-        line = line.substr(0, pos) + line.substr(pos+3);
+        }
+        else if(option.compare(0, 7, "--seed=") == 0)
+        {
+            job.fuzzSeed = strtoull(option.substr(7).c_str(), NULL, 0);
 
-        //we only accept $rs, $rt and $rd here
-        if(reg == "$rs")
-            regOrder.push_back(Instruction::rs);
-        else if(reg == "$rt")
-            regOrder.push_back(Instruction::rt);
-        else if(reg == "$rd")
-            regOrder.push_back(Instruction::rd);
+        }
+        else if(option.compare(0, 10, "--threads=") == 0)
+        {
+            //0 means one thread per core
+            job.threadCount = atoi(option.substr(10).c_str());
+            if(job.threadCount <= 0)
+            {
+                job.threadCount = std::thread::hardware_concurrency();
 
-    }
+            }
 
-    int commas = std::count(line.begin(), line.end(), ',');
-    bool parens = line.find('(') != std::string::npos && line.find(')') != std::string::npos;
-    
+        }
+        else
+        {
+            return false;
 
-    //build the instruction data
-    Instruction instr;
-    instr.opname = opname;
-    instr.opcode = opcode;
-    instr.funct = 0;
-    instr.type = type;
-    instr.regOrder = regOrder;
-    instr.flag = Instruction::None;
-    instr.commaCount = commas;
-    instr.hasParens = parens;
-    
-    return instr;
+        }
 
-}
+        return true;
 
-Instruction makeRType(std::string line, int opcode, int funct)
-{
-    Instruction instr = makeInstruction(line, Instruction::R, opcode);
-    instr.funct = funct; //assign the function
+    }
 
-    return instr;
+    if(option.find('x') != std::string::npos)
+        job.format.hex = true;
 
-}
+    if(option.find('d') != std::string::npos)
+        job.disassemble = true;
 
-Instruction makeIType(std::string line, int opcode, Instruction::Flag flag)
-{
-    Instruction instr = makeInstruction(line, Instruction::I, opcode);
-    instr.flag = flag; //assign a special function
+    if(option.find('b') != std::string::npos)
+        job.format.binary = true;
 
-    return instr;
+    if(option.find('p') != std::string::npos)
+        job.format.programCounter = true;
 
-}
+    if(option.find('r') != std::string::npos)
+        job.format.raw = true;
 
-Instruction makeJType(std::string line, int opcode)
-{
-    Instruction instr = makeInstruction(line, Instruction::J, opcode);
-    instr.flag = Instruction::Jump;
+    if(option.find('c') != std::string::npos)
+        job.objectOutput = true;
 
-    return instr;
+    if(option.find('e') != std::string::npos)
+        job.format.elf = true;
 
-}
+    if(option.find('l') != std::string::npos)
+        job.labelOutput = true;
 
-void initInstructions()
-{
-    instructions.clear();
-
-    //rtype instructions
-    instructions.push_back(makeRType("add $rd, $rs, $rt", 0x0, 0x20));
-    instructions.push_back(makeRType("sub $rd, $rs, $rt", 0x0, 0x22));
-    instructions.push_back(makeRType("and $rd, $rs, $rt", 0x0, 0x24));
-    instructions.push_back(makeRType("or $rd, $rs, $rt", 0x0, 0x25));
-    instructions.push_back(makeRType("nor $rd, $rs, $rt", 0x0, 0x27));
-    instructions.push_back(makeRType("slt $rd, $rs, $rt", 0x0, 0x2a));
-    instructions.push_back(makeRType("sll $rd, $rt, shamt", 0x0, 0x0));
-    instructions.push_back(makeRType("srl $rd, $rt, shamt", 0x0, 0x2));
-    instructions.push_back(makeRType("jr $rs", 0x0, 0x8));
-
-    //itype instructions
-    instructions.push_back(makeIType("addi $rt, $rs, imm", 0x8));
-    instructions.push_back(makeIType("andi $rt, $rs, imm", 0xc));
-    instructions.push_back(makeIType("ori $rt, $rs, imm", 0xd));
-    instructions.push_back(makeIType("beq $rs, $rt, offset", 0x4, Instruction::Jump));
-    instructions.push_back(makeIType("bne $rs, $rt, offset", 0x5, Instruction::Jump));
-    instructions.push_back(makeIType("lw $rt, offset($rs)", 0x23, Instruction::Offset));
-    instructions.push_back(makeIType("sw $rt, offset($rs)", 0x2b, Instruction::Offset));
-
-    //j type instructions
-    instructions.push_back(makeJType("j target", 0x2));
-    instructions.push_back(makeJType("jal target", 0x3));
+    return true;
 
 }
 
-Instruction getInstruction(std::string opname)
+bool runJob(Job& job)
 {
-    for(unsigned int i = 0; i < instructions.size(); i++)
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //a job on one thread only allocates on this thread, otherwise count the whole process
+    bool local = job.threadCount <= 1;
+    unsigned long allocations = local ? threadAllocationCount : allocationCount.load();
+    unsigned long allocated = local ? threadAllocationBytes : allocationBytes.load();
+
+    //if no output type flag is set
+    if(!job.format.hex && !job.format.binary)
+    {
+        job.format.binary = true;
+
+    }
+
+    //open the input file, the linker opens its objects itself
+    //the runners count what they read since stdin has no size up front
+    std::ifstream inputFile;
+    std::istream* input = NULL;
+    bool linking = job.objectPaths.size() > 0;
+    job.bytesRead = 0;
+    if(!linking)
     {
-        if(opname == instructions[i].opname)
+        input = openInput(job.inputPath, inputFile);
+
+        if(input == NULL)
         {
-            return instructions[i];
+            *job.log << "failed to open input file: " << job.inputPath << "\n";
+            return false;
 
         }
 
     }
 
-    Instruction instr;
-    instr.type = Instruction::Error;
-    return instr;
+    //open the output file
+    OutputSink output = makeOutputSink();
+    if(!openSink(output, job.outputPath))
+    {
+        *job.log << "failed to open output file: " << job.outputPath << "\n";
+        return false;
 
-}
+    }
 
-Instruction getInstruction(std::bitset<32> bitInstr)
-{
-    //pull the opcode
-    std::bitset<6> opcode(0);
-    for(unsigned int i = 26, k = 0; i < 32; i++, k++)
+    if(linking)
+        job.ok = runLinker(job, output);
+    else if(job.disassemble)
+        job.ok = runDisassembler(job, *input, output);
+    else
+        job.ok = runAssembler(job, *input, output);
+
+    if(!closeSink(output))
+    {
+        *job.log << "failed to write output file: " << job.outputPath << "\n";
+        job.ok = false;
+
+    }
+
+    job.bytesWritten = output.written;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    job.seconds = elapsed.count();
+
+    job.stats.bytesRead = job.bytesRead;
+    job.stats.bytesWritten = job.bytesWritten;
+    job.stats.allocations = (local ? threadAllocationCount : allocationCount.load()) - allocations;
+    job.stats.allocatedBytes = (local ? threadAllocationBytes : allocationBytes.load()) - allocated;
+    job.stats.peakRssKb = peakRss();
+
+    if(job.printStats)
     {
-        opcode[k] = bitInstr[i];
+        printStats(job);
 
     }
 
-    //if this has an opcode of 0 we need to get the funct
-    std::bitset<6> funct(0);
-    if(opcode == std::bitset<6>(0))
+    if(job.statsPath.size() > 0)
     {
-        for(unsigned int i = 0, k = 0; i < 6; i++, k++)
+        std::ofstream statsFile(job.statsPath.c_str());
+        if(!statsFile)
         {
-            funct[k] = bitInstr[i];
+            *job.log << "failed to open stats file: " << job.statsPath << "\n";
 
         }
 
+        writeStatsJson(job, statsFile);
+
     }
 
-    //find the corresponding instruction
-    for(unsigned int i = 0; i < instructions.size(); i++)
+    return job.ok;
+
+}
+
+bool runAssembler(Job& job, std::istream& input, OutputSink& output)
+{
+    AssembleResult result;
+
+    //the clock is only read when someone is going to look at the times
+    bool timing = job.printStats || job.statsPath.size() > 0;
+    double readSeconds = 0.0;
+    std::chrono::steady_clock::time_point mark;
+
+    //objects, the cache and the parallel assembler need the whole source, otherwise stream it
+    if(job.objectOutput)
     {
-        std::bitset<6> instrOpcode(instructions[i].opcode);
-        std::bitset<6> instrFunct(instructions[i].funct);
-        if(instrOpcode == opcode && instrFunct == funct)
+        mark = std::chrono::steady_clock::now();
+        std::string source;
+        readWhole(input, source);
+        job.bytesRead = source.size();
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+        ObjectResult object = assembleObject(source, timing);
+
+        mark = std::chrono::steady_clock::now();
+        for(unsigned int i = 0; i < object.diagnostics.size(); i++)
+        {
+            *job.log << object.diagnostics[i];
+
+        }
+
+        if(object.ok)
         {
-            return instructions[i];
+            saveObject(object.module, output.buffer);
+            flushSink(output, true);
 
         }
 
+        job.stats = object.stats;
+        job.stats.readSeconds = readSeconds;
+        job.stats.outputSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+        return object.ok;
+
     }
+    else if(job.cachePath.size() > 0)
+    {
+        mark = std::chrono::steady_clock::now();
+        std::string source;
+        readWhole(input, source);
+        job.bytesRead = source.size();
+        RegionCache cache;
+        readRegionCache(job.cachePath, cache);
+        size_t cached = cache.regions.size();
+        bool laidOut = cached == 0 || cache.regions[0].base >= 0;
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+        result = assembleIncremental(source, cache, timing);
+
+        //nothing to write back when every region came from a cache that was already laid out
+        bool unchanged = laidOut && result.stats.reusedRegions == cached && cache.regions.size() == cached;
+        if(!unchanged && !writeRegionCache(job.cachePath, cache))
+        {
+            *job.log << "failed to write cache file: " << job.cachePath << "\n";
 
-    Instruction instr;
-    instr.type = Instruction::Error;
-    return instr;
+        }
 
-}
+    }
+    else if(job.threadCount > 1)
+    {
+        mark = std::chrono::steady_clock::now();
+        std::string source;
+        readWhole(input, source);
+        job.bytesRead = source.size();
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
 
-std::bitset<5> pullRegister(std::bitset<32> bitInstr, int lower, int upper)
-{
-    std::bitset<5> reg;
-    for(unsigned int i = lower, k = 0; i < upper; i++, k++)
+        result = assemble(source, job.threadCount, timing);
+
+    }
+    else
     {
-        reg[k] = bitInstr[i];
+        return streamAssembler(job, input, output);
 
     }
-    return reg;
+
+    mark = std::chrono::steady_clock::now();
+
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
+    {
+        *job.log << result.diagnostics[i];
+
+    }
+
+    if(result.ok)
+    {
+        writeProgram(job, result, output);
+
+    }
+
+    job.stats = result.stats;
+    job.stats.readSeconds = readSeconds;
+    job.stats.outputSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+    job.symbols = result.symbols;
+
+    return result.ok;
 
 }
 
-bool writeInstruction(Instruction instr, std::vector<int> regs, int num, std::ofstream& output)
+bool streamAssembler(Job& job, std::istream& input, OutputSink& output)
 {
-    //check if we have enough reg values for this instruction
-    if(instr.regOrder.size() != regs.size())
+    bool timing = job.printStats || job.statsPath.size() > 0;
+    double readSeconds = 0.0;
+    double outputSeconds = 0.0;
+    std::chrono::steady_clock::time_point mark;
+
+    //words go out as soon as no label operand is waiting on them, so only the labels, the
+    //unresolved references and the words from the oldest of them on are held. elf output and
+    //--mmap need every word before anything is written so they keep them all
+    bool streaming = !job.format.elf && !job.mapOutput;
+    size_t wordsOut = 0;
+    std::vector<uint32_t> ready;
+
+    if(streaming)
     {
-        std::cout << "not enough reg values. expected: " << instr.regOrder.size() << "\n";
-        return false;
+        std::string header;
+        formatHeader(job.format, header);
+        writeSink(output, header.data(), header.size());
 
     }
 
-    //write the opcode which is always 6 bits
-    std::bitset<6> opbits(instr.opcode);
+    Assembly assembly = makeAssembly(timing);
 
-    std::stringstream out;
-    out << opbits;
+    //lines are cut straight out of the chunk, only one that runs over the end of it is copied
+    std::vector<char> chunk(readChunkSize);
+    std::string carried;
+    bool assembling = true;
 
-    //rtype instruction
-    if(instr.type == Instruction::R)
+    while(assembling && input)
     {
-        std::bitset<5> rs(0);
-        std::bitset<5> rt(0);
-        std::bitset<5> rd(0);
+        mark = std::chrono::steady_clock::now();
+        input.read(&chunk[0], chunk.size());
+        size_t size = input.gcount();
+        job.bytesRead += size;
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+        const char* begin = &chunk[0];
+        const char* end = begin + size;
+        while(assembling)
+        {
+            const char* newline = (const char*)memchr(begin, '\n', end - begin);
+            if(newline == NULL)
+            {
+                carried.append(begin, end - begin);
+                break;
+
+            }
+
+            if(carried.size() > 0)
+            {
+                carried.append(begin, newline - begin);
+                assembling = assembleLine(assembly, carried);
+                carried.clear();
+
+            }
+            else
+            {
+                assembling = assembleLine(assembly, std::string_view(begin, newline - begin));
+
+            }
+
+            begin = newline + 1;
+
+        }
 
-        //set the register values in order
-        for(unsigned int i = 0; i < regs.size(); i++)
+        if(streaming)
         {
-            Instruction::RegType t = instr.regOrder[i];
-            if(t == Instruction::rs)
-                rs = std::bitset<5>(regs[i]);
-            else if(t == Instruction::rt)
-                rt = std::bitset<5>(regs[i]);
-            else if(t == Instruction::rd)
-                rd = std::bitset<5>(regs[i]);
+            mark = std::chrono::steady_clock::now();
+            ready.clear();
+            takeWords(assembly, ready);
+            formatWords(job.format, ready.data(), ready.size(), 0x00400000 + wordsOut * 4, output.buffer);
+            wordsOut += ready.size();
+            flushSink(output, false);
+            outputSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
 
         }
 
-        std::bitset<5> shamt(num);
+    }
+
+    //the last line does not need a newline
+    if(assembling && carried.size() > 0)
+    {
+        assembleLine(assembly, carried);
 
-        std::bitset<6> funct(instr.funct);
+    }
 
-        out << rs << rt << rd << shamt << funct;
+    AssembleResult result = finishAssembly(assembly);
+
+    mark = std::chrono::steady_clock::now();
+
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
+    {
+        *job.log << result.diagnostics[i];
 
     }
-    else if(instr.type == Instruction::I)
+
+    if(result.ok && streaming)
+    {
+        formatWords(job.format, result.words.data(), result.words.size(), 0x00400000 + wordsOut * 4, output.buffer);
+        flushSink(output, true);
+
+    }
+    else if(result.ok)
+    {
+        writeProgram(job, result, output);
+
+    }
+    else
+    {
+        //a file is left empty on an error like before, a pipe already has what was written
+        discardSink(output);
+
+    }
+
+    job.stats = result.stats;
+    job.stats.readSeconds = readSeconds;
+    job.stats.outputSeconds = outputSeconds + std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+    job.symbols = result.symbols;
+
+    return result.ok;
+
+}
+
+bool runLinker(Job& job, OutputSink& output)
+{
+    bool timing = job.printStats || job.statsPath.size() > 0;
+    std::chrono::steady_clock::time_point mark = std::chrono::steady_clock::now();
+
+    std::vector<ObjectModule> modules(job.objectPaths.size());
+    for(unsigned int i = 0; i < job.objectPaths.size(); i++)
     {
-        //TODO: calculate jump length offset somewhere in here.
-        std::bitset<5> rs(0);
-        std::bitset<5> rt(0);
+        std::ifstream file(job.objectPaths[i].c_str(), std::ios::in | std::ios::binary);
+        if(!file)
+        {
+            *job.log << "failed to open input file: " << job.objectPaths[i] << "\n";
+            return false;
 
-        //set the register values in order
-        for(unsigned int i = 0; i < regs.size(); i++)
+        }
+
+        std::string data;
+        readWhole(file, data);
+        job.bytesRead += data.size();
+
+        if(!loadObject(modules[i], data.data(), data.size()))
         {
-            Instruction::RegType t = instr.regOrder[i];
-            if(t == Instruction::rs)
-                rs = std::bitset<5>(regs[i]);
-            else if(t == Instruction::rt)
-                rt = std::bitset<5>(regs[i]);
+            *job.log << "not a valid object file: " << job.objectPaths[i] << "\naborting\n";
+            return false;
 
         }
 
-        std::bitset<16> imm(num);
+    }
 
-        out << rs << rt << imm;
+    double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+    AssembleResult result = link(modules, timing);
+
+    mark = std::chrono::steady_clock::now();
+
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
+    {
+        *job.log << result.diagnostics[i];
 
     }
-    else if(instr.type == Instruction::J)
+
+    if(result.ok)
     {
-        std::bitset<26> target(num);
-        out << target;
+        writeProgram(job, result, output);
 
     }
 
-    std::string line;
-    out >> line;
+    job.stats = result.stats;
+    job.stats.readSeconds = readSeconds;
+    job.stats.outputSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+    job.symbols = result.symbols;
+
+    return result.ok;
 
-    if(programCounter)
+}
+
+bool runSimulator(Job& job)
+{
+    std::ifstream inputFile;
+    std::istream* input = openInput(job.inputPath, inputFile);
+    if(input == NULL)
     {
-        output << "0x" << std::hex << std::setfill('0') << std::setw(8) << pc << "\t";
+        *job.log << "failed to open input file: " << job.inputPath << "\n";
+        return false;
 
     }
 
-    //output in hexadecimal format
-    if(hexOutput)
+    std::vector<uint32_t> words;
+    uint32_t entry = 0x00400000;
+    if(!readProgram(job, *input, words, entry))
     {
-        std::bitset<32> hexVal(line);
-        output << "0x" << std::hex << std::setfill('0') << std::setw(8) << hexVal.to_ulong();
-        if(binaryOutput)
+        return false;
+
+    }
+
+    SimResult result = simulate(words, entry, job.maxSteps);
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
+    {
+        *job.log << result.diagnostics[i];
+
+    }
+
+    double mips = result.seconds > 0.0 ? result.steps / result.seconds / 1000000.0 : 0.0;
+    *job.log << "retired " << result.steps << " instructions in " << result.seconds << " s (" << mips << " MIPS)\n";
+
+    //only the registers that hold something
+    char value[32];
+    for(int i = 1; i < 32; i++)
+    {
+        if(result.regs[i] != 0)
         {
-            output << "\t";
+            snprintf(value, sizeof(value), " = 0x%08x (%d)\n", result.regs[i], (int32_t)result.regs[i]);
+            *job.log << registerName(i) << value;
 
         }
 
     }
 
-    if(binaryOutput)
+    return result.ok;
+
+}
+
+bool runVerifier(Job& job)
+{
+    std::ifstream inputFile;
+    std::istream* input = openInput(job.inputPath, inputFile);
+    if(input == NULL)
+    {
+        *job.log << "failed to open input file: " << job.inputPath << "\n";
+        return false;
+
+    }
+
+    std::string source;
+    readWhole(*input, source);
+
+    VerifyResult result = verifyRoundTrip(source, job.threadCount);
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
     {
-        output << line;
+        *job.log << result.diagnostics[i];
 
     }
 
-    output << "\n";
+    if(result.ok)
+    {
+        *job.log << job.inputPath << ": " << result.words << " words round trip\n";
 
-    return true;
+    }
+
+    return result.ok;
 
 }
 
-void writeInstruction(Instruction instr, std::bitset<32> bitInstr, std::ofstream& output)
+bool runFuzzer(Job& job)
 {
-    output << instr.opname << " ";
-    if(instr.type == Instruction::R)
+    FuzzResult result = fuzz(job.fuzzCases, job.fuzzSeed, job.threadCount);
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
     {
-        //read all the register values
-        std::bitset<5> rs = pullRegister(bitInstr, 21, 26);
-        std::bitset<5> rt = pullRegister(bitInstr, 16, 21);
-        std::bitset<5> rd = pullRegister(bitInstr, 11, 16);
-        std::bitset<5> shamt = pullRegister(bitInstr, 6, 11);
+        *job.log << result.diagnostics[i];
 
-        for(unsigned int i = 0; i < instr.regOrder.size(); i++)
-        {
-            Instruction::RegType t = instr.regOrder[i];
-            if(t == Instruction::rs)
-                output << getRegName(rs.to_ulong());
-            else if(t == Instruction::rt)
-                output << getRegName(rt.to_ulong());
-            else if(t == Instruction::rd)
-                output << getRegName(rd.to_ulong());
+    }
 
-            if(i != instr.regOrder.size()-1)
+    double rate = result.seconds > 0.0 ? result.cases / result.seconds / 1000000.0 : 0.0;
+    *job.log << result.cases << " cases, " << result.failures << " failures in " << result.seconds << " s (" << rate << " M cases/s)\n";
+
+    return result.ok;
+
+}
+
+bool readProgram(Job& job, std::istream& input, std::vector<uint32_t>& words, uint32_t& entry)
+{
+    //-d means the input is already machine code in any of the formats the disassembler takes
+    if(job.disassemble)
+    {
+        std::vector<char> chunk(64 * 1024);
+        std::string error;
+        ImageReader reader = makeImageReader();
+        while(input)
+        {
+            input.read(&chunk[0], chunk.size());
+            if(!readImage(reader, &chunk[0], input.gcount(), words, error))
             {
-                output << ", ";
+                *job.log << error;
+                return false;
 
             }
 
         }
 
-        if(shamt.to_ulong() > 0)
+        if(!finishImage(reader, error))
+        {
+            *job.log << error;
+            return false;
+
+        }
+
+        if(reader.format == ImageReader::Elf)
         {
-            output << ", " << shamt.to_ulong();
+            entry = reader.entry;
 
         }
 
+        return true;
+
     }
-    else if(instr.type == Instruction::I)
+
+    std::string source;
+    readWhole(input, source);
+
+    AssembleResult result = assemble(source, job.threadCount);
+    for(unsigned int i = 0; i < result.diagnostics.size(); i++)
     {
-        std::bitset<5> rs = pullRegister(bitInstr, 21, 26);
-        std::bitset<5> rt = pullRegister(bitInstr, 16, 21);
+        *job.log << result.diagnostics[i];
+
+    }
 
-        //read 16 bit immediate value
-        std::bitset<16> imm(0);
-        for(unsigned int i = 0, k = 0; i < 16; i++, k++)
+    //start at main like the elf entry point does
+    for(unsigned int i = 0; i < result.labels.size(); i++)
+    {
+        const Label& label = result.labels[i];
+        if(label.name == "main" && label.defined)
         {
-            imm[k] = bitInstr[i];
+            entry = label.address + (label.last ? 4 : 0);
 
         }
 
-        for(unsigned int i = 0; i < instr.regOrder.size(); i++)
+    }
+
+    words.swap(result.words);
+    return result.ok;
+
+}
+
+void writeProgram(const Job& job, const AssembleResult& result, OutputSink& output)
+{
+    const std::vector<uint32_t>& words = result.words;
+
+    //elf output needs the labels as well and is small next to the text formats
+    if(job.format.elf)
+    {
+        formatElf(job.format, words, result.labels, output.buffer);
+        flushSink(output, true);
+        return;
+
+    }
+
+    std::string header;
+    formatHeader(job.format, header);
+
+    //the size is known exactly so formatting can go straight into the mapped file
+    size_t size = header.size() + formatSize(job.format, words.size());
+    if(job.mapOutput && mapSink(output, size))
+    {
+        memcpy(output.map, header.data(), header.size());
+        formatWords(job.format, words.data(), words.size(), 0x00400000, output.map + header.size());
+
+    }
+    else
+    {
+        writeSink(output, header.data(), header.size());
+
+        //format a block of words at a time straight into the buffer
+        const size_t block = 4096;
+        for(size_t i = 0; i < words.size(); i += block)
         {
-            Instruction::RegType t = instr.regOrder[i];
-            if(t == Instruction::rs)
-            {
-                //handle things like 8($s0)
-                if(instr.flag == Instruction::Offset)
-                {
-                    int immediate = imm.to_ulong();
-                    //hackiest hack of all hacks to read the negative number
-                    uint16_t full = -1;
-                    uint16_t half = full/2;
-                    if(immediate > half)
-                    {
-                        immediate -= full;
-                        immediate -= 1;
+            size_t count = std::min(block, words.size() - i);
+            formatWords(job.format, &words[i], count, 0x00400000 + i * 4, output.buffer);
+            flushSink(output, false);
 
-                    }
+        }
 
-                    output << immediate;
-                    output << "(" << getRegName(rs.to_ulong()) << ")";
+    }
 
-                }
-                else
-                {
-                    output << getRegName(rs.to_ulong());
+    flushSink(output, true);
 
-                }
+}
 
-            }
-            else if(t == Instruction::rt)
-            {
-                output << getRegName(rt.to_ulong());
+bool runDisassembler(Job& job, std::istream& input, OutputSink& output)
+{
+    //read the input in fixed size chunks so memory stays bounded no matter how big the file is
+    std::vector<char> chunk(readChunkSize);
+    std::vector<uint32_t> words;
+    std::string error;
 
-            }
+    ImageReader reader = makeImageReader();
+
+    bool timing = job.printStats || job.statsPath.size() > 0;
+    std::chrono::steady_clock::time_point mark;
+    job.stats = makeRunStats();
+
+    //with several threads words are gathered into blocks big enough to be worth splitting up,
+    //labels can point anywhere so they need every word at once
+    size_t block = job.threadCount > 1 ? parallelBlockWords : 0;
+    if(job.labelOutput)
+    {
+        block = (size_t)-1;
+
+    }
+    size_t wordBase = 0;
+
+    while(input)
+    {
+        mark = std::chrono::steady_clock::now();
+        input.read(&chunk[0], chunk.size());
+        job.bytesRead += input.gcount();
+        job.stats.readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
 
-            if(i != instr.regOrder.size()-1)
+        mark = std::chrono::steady_clock::now();
+        bool read = readImage(reader, &chunk[0], input.gcount(), words, error);
+        job.stats.lexSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+        if(read && input && words.size() < block)
+        {
+            continue;
+
+        }
+
+        //everything before a bad character or instruction still gets written
+        if(job.threadCount > 1 || job.labelOutput)
+        {
+            DisassembleResult result;
+            if(job.labelOutput)
+                result = disassembleLabeled(words, job.threadCount, timing);
+            else
+                result = disassemble(words, job.threadCount, timing);
+
+            addRunStats(job.stats, result.stats);
+            writeSink(output, result.text.data(), result.text.size());
+
+            if(!result.ok)
             {
-                output << ", ";
+                flushSink(output, true);
+                *job.log << unsupportedWord(wordBase + result.badWord, words[result.badWord]);
+                return false;
 
             }
 
         }
-
-        if(instr.flag != Instruction::Offset)
+        else
         {
-            int immediate = imm.to_ulong();
-            if(instr.flag == Instruction::Jump)
+            for(unsigned int i = 0; i < words.size(); i++)
             {
-                //hackiest hack of all hacks to read the negative number
-                uint16_t full = -1;
-                uint16_t half = full/2;
-                if(immediate > half)
+                if(!disassembleWord(words[i], output.buffer, job.stats, timing))
                 {
-                    immediate -= full;
-                    immediate -= 1;
+                    flushSink(output, true);
+                    *job.log << unsupportedWord(wordBase + i, words[i]);
+                    return false;
 
                 }
-                immediate *= 4;
 
             }
 
-            output << ", " << immediate;
-
         }
 
-    }
-    else if(instr.type == Instruction::J)
-    {
-        //read 26 bit target address
-        std::bitset<26> target(0);
-        for(unsigned int i = 0, k = 0; i < 26; i++, k++)
+        wordBase += words.size();
+        words.clear();
+
+        mark = std::chrono::steady_clock::now();
+        flushSink(output, !read);
+        job.stats.outputSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+        if(!read)
         {
-            target[k] = bitInstr[i];
+            *job.log << error;
+            return false;
 
         }
 
-        int value = target.to_ulong();
-        value *= 4;
-        
-        output << value;
+    }
+
+    mark = std::chrono::steady_clock::now();
+    flushSink(output, true);
+    job.stats.outputSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mark).count();
+
+    if(!finishImage(reader, error))
+    {
+        *job.log << error;
+        return false;
 
     }
 
-    output << "\n";
+    return true;
+
+}
+
+OutputSink makeOutputSink()
+{
+    OutputSink sink;
+    sink.fd = -1;
+    sink.failed = false;
+    sink.written = 0;
+    sink.map = NULL;
+    sink.mapSize = 0;
+    sink.isFile = true;
+    return sink;
 
 }
 
-void initRegs()
+bool openSink(OutputSink& sink, const std::string& path)
 {
-    nameToReg.clear();
+    if(path == "-")
+    {
+        sink.fd = dup(STDOUT_FILENO);
+        sink.isFile = false;
+        sink.buffer.reserve(sinkBlockSize + sinkBlockSize / 2);
+        return sink.fd >= 0;
+
+    }
 
-    //all the reg names in order
-    std::string names = "$zero $at $v0 $v1 $a0 $a1 $a2 $a3 $t0 $t1 "
-                        "$t2 $t3 $t4 $t5 $t6 $t7 $s0 $s1 $s2 $s3 $s4 "
-                        "$s5 $s6 $s7 $t8 $t9 $k0 $k1 $gp $sp $fp $ra";
+    //read/write so the file can be mapped later
+    sink.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    sink.buffer.reserve(sinkBlockSize + sinkBlockSize / 2);
+    return sink.fd >= 0;
 
-    std::stringstream ss(names);
+}
 
-    //separate the reg names for the vector    
-    std::string reg;
-    while(std::getline(ss, reg, ' '))
+bool mapSink(OutputSink& sink, size_t size)
+{
+    //only an empty file can be sized up front, and anything not a regular file can't be mapped
+    if(!sink.isFile || size < sinkMapMinimum || sink.written > 0 || sink.buffer.size() > 0 || sink.map != NULL)
     {
-        nameToReg.push_back(reg);
+        return false;
 
     }
 
-    //print reg map for debug
-    /*for(unsigned int i = 0; i < nameToReg.size(); i++)
+    if(ftruncate(sink.fd, size) != 0)
     {
-        std::cout << "reg " << i << " is " << nameToReg[i] << "\n";
-
-    }*/
+        return false;
 
-}
+    }
 
-int getRegNum(std::string reg)
-{
-    //find the index of the register
-    for(unsigned int i = 0; i < nameToReg.size(); i++)
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sink.fd, 0);
+    if(map == MAP_FAILED)
     {
-        if(reg == nameToReg[i])
+        //leave the file as it was for the buffered path
+        if(ftruncate(sink.fd, 0) != 0)
         {
-            return i;
+            sink.failed = true;
 
         }
 
+        return false;
+
     }
 
-    return -1;
+    sink.map = (char*)map;
+    sink.mapSize = size;
+    sink.written = size;
+    return true;
 
 }
 
-std::string getRegName(int num)
+void writeSink(OutputSink& sink, const char* data, size_t size)
 {
-    return nameToReg[num];
+    if(sink.buffer.size() + size <= sinkBlockSize)
+    {
+        sink.buffer.append(data, size);
+        return;
+
+    }
+
+    //a big piece goes out together with the buffer in one writev instead of being copied
+    if(size >= sinkBlockSize / 2)
+    {
+        struct iovec parts[2];
+        parts[0].iov_base = &sink.buffer[0];
+        parts[0].iov_len = sink.buffer.size();
+        parts[1].iov_base = (void*)data;
+        parts[1].iov_len = size;
+
+        sink.failed = !writeFully(sink.fd, parts, 2) || sink.failed;
+        sink.written += sink.buffer.size() + size;
+        sink.buffer.clear();
+        return;
+
+    }
+
+    flushSink(sink, true);
+    sink.buffer.append(data, size);
 
 }
 
-Label makeLabel(std::string name)
+void flushSink(OutputSink& sink, bool force)
 {
-    Label label;
-    label.name = name;
-    label.address = -1;
-    label.last = false;
-    return label;
+    if(sink.buffer.size() >= sinkBlockSize || (force && sink.buffer.size() > 0))
+    {
+        struct iovec part;
+        part.iov_base = &sink.buffer[0];
+        part.iov_len = sink.buffer.size();
+
+        sink.failed = !writeFully(sink.fd, &part, 1) || sink.failed;
+        sink.written += sink.buffer.size();
+        sink.buffer.clear();
+
+    }
 
 }
 
-Label getLabel(std::string name)
+bool closeSink(OutputSink& sink)
 {
-    for(unsigned int i = 0; i < labels.size(); i++)
+    flushSink(sink, true);
+
+    if(sink.map != NULL)
     {
-        if(labels[i].name == name)
-        {
-            return labels[i];
+        sink.failed = munmap(sink.map, sink.mapSize) != 0 || sink.failed;
+        sink.map = NULL;
 
-        }
+    }
+
+    if(sink.fd >= 0)
+    {
+        sink.failed = close(sink.fd) != 0 || sink.failed;
+        sink.fd = -1;
 
     }
 
-    return makeLabel("erorr");
+    return !sink.failed;
 
 }
 
-void assembler(std::fstream& input, std::ofstream& output)
+void discardSink(OutputSink& sink)
 {
-    pc = 0x00400000;
-    std::stringstream ss; //for reading the file the second time.
+    sink.buffer.clear();
 
-    //parse for labels and comments
-    std::string line;
-    while(std::getline(input, line))
+    if(sink.isFile && sink.map == NULL && sink.written > 0)
     {
-        ss << line << "\n";
+        sink.failed = ftruncate(sink.fd, 0) != 0 || sink.failed;
+        sink.written = 0;
 
-        //remove comment
-        if(line.find('#') != std::string::npos)
-        {
-            line = line.substr(0, line.find('#'));
+    }
 
-        }
+}
 
-        line = trim(line);
+std::istream* openInput(const std::string& path, std::ifstream& file)
+{
+    if(path == "-")
+    {
+        return &std::cin;
 
-        //parse for labels
-        if(line.find(':') != std::string::npos)
-        {
-            int pos = line.find(':');
-            std::string label = line.substr(0, pos);
+    }
 
-            std::string alphanumeric("_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890");
-            if(label.find_first_not_of(alphanumeric) != std::string::npos)
-            {
-                std::cout << "label error: \"" << label << "\"\n";
-                std::cout << "labels may only contain alphanumeric characters\naborting\n";
-                return;
+    file.open(path.c_str(), std::ios::in | std::ios::binary);
+    return file ? &file : NULL;
 
-            }
+}
 
-            std::string numbers("0123456789");
-            if(label.find_first_of(numbers) == 0)
+bool writeFully(int fd, struct iovec* parts, int count)
+{
+    //writev can stop part way through, carry on from wherever it got to
+    while(count > 0)
+    {
+        ssize_t done = writev(fd, parts, count);
+        if(done < 0)
+        {
+            if(errno == EINTR)
             {
-                std::cout << "label error: \"" << label << "\"\n";
-                std::cout << "labels may not start with a number\naborting\n";
-                return;
+                continue;
 
             }
 
-            line = line.substr(pos+1);
-            line = trim(line);
-            labels.push_back(makeLabel(label));
+            return false;
 
         }
 
-        //if line is empty after trim/remove comment skip
-        if(line.size() == 0)
+        while(count > 0 && (size_t)done >= parts[0].iov_len)
         {
-            continue;
+            done -= parts[0].iov_len;
+            parts++;
+            count--;
 
         }
 
-        //set the address of the label to the next line of actual code
-        if(labels.size() > 0)
+        if(count > 0)
         {
-            Label& label = labels[labels.size()-1];
-            if(label.address < 0)
-            {
-                label.address = pc;
-                //std::cout << "label \"" << label.name << "\" at address " << label.address << "\n";
-
-            }
+            parts[0].iov_base = (char*)parts[0].iov_base + done;
+            parts[0].iov_len -= done;
 
         }
 
-        pc += 0x000004;
+    }
+
+    return true;
+
+}
+
+void printStats(const Job& job)
+{
+    const RunStats& stats = job.stats;
+
+    *job.log << "read: " << stats.readSeconds * 1000.0 << " ms\n";
+    *job.log << "label pass: " << stats.labelSeconds * 1000.0 << " ms\n";
+    *job.log << "lexing: " << stats.lexSeconds * 1000.0 << " ms\n";
+    *job.log << "lookup: " << stats.lookupSeconds * 1000.0 << " ms\n";
+    *job.log << "encoding: " << stats.encodeSeconds * 1000.0 << " ms\n";
+    *job.log << "output: " << stats.outputSeconds * 1000.0 << " ms\n";
+
+    *job.log << "lines: " << stats.lines << "\n";
+    *job.log << "instructions: " << stats.rTypes + stats.iTypes + stats.jTypes;
+    *job.log << " (R " << stats.rTypes << ", I " << stats.iTypes << ", J " << stats.jTypes << ")\n";
+    *job.log << "labels: " << stats.labels << ", fixups: " << stats.fixups << "\n";
+    if(job.cachePath.size() > 0)
+    {
+        *job.log << "regions: " << stats.regions << " (" << stats.reusedRegions << " from the cache)\n";
 
     }
 
-    //check for putting a label at the end of code like an exit label
-    for(unsigned int i = 0; i < labels.size(); i++)
+    *job.log << "bytes read: " << stats.bytesRead << ", bytes written: " << stats.bytesWritten << "\n";
+    *job.log << "allocations: " << stats.allocations << " (" << stats.allocatedBytes << " bytes)\n";
+    *job.log << "peak memory: " << stats.peakRssKb << " KB\n";
+
+    //only the assembler has a symbol table
+    if(!job.disassemble)
     {
-        Label& label = labels[i];
-        if(label.address < 0)
-        {
-            label.address = pc - 0x000004;
-            label.last = true;
+        const SymbolStats& symbols = job.symbols;
+        double load = symbols.slots > 0 ? (double)symbols.labels / symbols.slots : 0.0;
+        double probes = symbols.lookups > 0 ? (double)symbols.probes / symbols.lookups : 0.0;
 
-        }
+        *job.log << "symbol table: " << symbols.labels << " labels in " << symbols.slots << " slots\n";
+        *job.log << "load factor: " << load << "\n";
+        *job.log << "lookups: " << symbols.lookups << " (" << probes << " extra probes per lookup)\n";
 
     }
 
-    //reset program counter
-    pc = 0x00400000;
-    int lineNum = 1;
+}
+
+void writeStatsJson(const Job& job, std::ostream& out)
+{
+    const RunStats& stats = job.stats;
+    const SymbolStats& symbols = job.symbols;
+
+    out << "{\n";
+    out << "  \"input\": \"" << job.inputPath << "\",\n";
+    out << "  \"output\": \"" << job.outputPath << "\",\n";
+    const char* mode = job.objectPaths.size() > 0 ? "link" : job.disassemble ? "disassemble" : "assemble";
+    out << "  \"mode\": \"" << mode << "\",\n";
+    out << "  \"ok\": " << (job.ok ? "true" : "false") << ",\n";
+    out << "  \"seconds\": " << job.seconds << ",\n";
+    out << "  \"phases\": {\"read\": " << stats.readSeconds << ", \"labels\": " << stats.labelSeconds;
+    out << ", \"lexing\": " << stats.lexSeconds << ", \"lookup\": " << stats.lookupSeconds;
+    out << ", \"encoding\": " << stats.encodeSeconds << ", \"output\": " << stats.outputSeconds << "},\n";
+    out << "  \"lines\": " << stats.lines << ",\n";
+    out << "  \"instructions\": {\"R\": " << stats.rTypes << ", \"I\": " << stats.iTypes << ", \"J\": " << stats.jTypes << "},\n";
+    out << "  \"labels\": " << stats.labels << ",\n";
+    out << "  \"fixups\": " << stats.fixups << ",\n";
+    out << "  \"regions\": " << stats.regions << ",\n";
+    out << "  \"reusedRegions\": " << stats.reusedRegions << ",\n";
+    out << "  \"bytesRead\": " << stats.bytesRead << ",\n";
+    out << "  \"bytesWritten\": " << stats.bytesWritten << ",\n";
+    out << "  \"allocations\": " << stats.allocations << ",\n";
+    out << "  \"allocatedBytes\": " << stats.allocatedBytes << ",\n";
+    out << "  \"peakRssKb\": " << stats.peakRssKb << ",\n";
+    out << "  \"symbolTable\": {\"labels\": " << symbols.labels << ", \"slots\": " << symbols.slots;
+    out << ", \"lookups\": " << symbols.lookups << ", \"probes\": " << symbols.probes << "}\n";
+    out << "}\n";
+
+}
+
+long peakRss()
+{
+    //kilobytes on linux, for the whole process
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+
+}
 
-    while(std::getline(ss, line))
+void readWhole(std::istream& input, std::string& out)
+{
+    //big reads straight into the string, a character at a time through the iterators is far slower
+    while(input)
     {
-        std::string fullLine = line;
-        //remove comment
-        if(line.find('#') != std::string::npos)
-        {
-            line = line.substr(0, line.find('#'));
+        size_t size = out.size();
+        out.resize(size + sinkBlockSize);
+        input.read(&out[size], sinkBlockSize);
+        out.resize(size + input.gcount());
 
-        }
+    }
 
-        line = trim(line);
+}
 
-        //parse for labels
-        if(line.find(':') != std::string::npos)
-        {
-            int pos = line.find(':');
-            line = line.substr(pos+1);
-            line = trim(line);
+void readRegionCache(const std::string& path, RegionCache& cache)
+{
+    //a missing or damaged cache just means everything gets assembled
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::string data;
+    readWhole(file, data);
+    loadRegionCache(cache, data.data(), data.size());
 
-        }
+}
 
-        //if line is empty after trim/remove comment skip
-        if(line.size() == 0)
-        {
-            lineNum++;
-            continue;
+bool writeRegionCache(const std::string& path, const RegionCache& cache)
+{
+    std::string data;
+    saveRegionCache(cache, data);
 
-        }
+    //written next to it and renamed over so an interrupted run never leaves half a cache
+    std::string temp = path + ".tmp";
+    std::ofstream file(temp.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+
+    if(!file || rename(temp.c_str(), path.c_str()) != 0)
+    {
+        remove(temp.c_str());
+        return false;
 
-        std::string opname;
+    }
 
-        //parse the opname
-        if(line.find(' ') != std::string::npos)
-        {
-            int pos = line.find(' ');
-            opname = line.substr(0, pos);
-            line = line.substr(pos+1);
+    return true;
 
-        }
+}
 
-        Instruction instr = getInstruction(opname);
-        if(instr.type == Instruction::Error)
+int runBatch(const std::string& manifestPath, const Job& defaults, int workers)
+{
+    std::ifstream manifest(manifestPath.c_str());
+    if(!manifest)
+    {
+        std::cout << "failed to open manifest: " << manifestPath << "\n";
+        return 1;
+
+    }
+
+    //one job per line: <inputfile> <outputfile> <options>
+    std::vector<Job> jobs;
+    std::string line;
+    int lineNum = 0;
+    while(std::getline(manifest, line))
+    {
+        lineNum++;
+        std::stringstream ss(line);
+        std::string word;
+        std::vector<std::string> words;
+        while(ss >> word)
         {
-            std::cout << opname << " is not a valid operation\naborting\n";
-            return;
+            words.push_back(word);
 
         }
 
-        int commas = std::count(line.begin(), line.end(), ',');
-        if(commas != instr.commaCount)
+        //skip blank lines and comments
+        if(words.size() == 0 || words[0][0] == '#')
         {
-            std::cout << "syntax error on line " << lineNum << ": " << fullLine << "\n";
-            std::cout << "missing \',\'\naborting\n";
-            return;
+            continue;
 
         }
 
-        bool parens = line.find('(') != std::string::npos && line.find(')') != std::string::npos;
-        if(parens != instr.hasParens)
+        if(words.size() < 2)
         {
-            std::cout << "syntax error on line " << lineNum << ": " << fullLine << "\n";
-            std::cout << "missing \'(\' or \')\'\naborting\n";
-            return;
+            std::cout << "manifest line " << lineNum << ": expected <inputfile> <outputfile> <options>\n";
+            return 1;
 
         }
 
-        //parse out the registers by looking for $
-        std::vector<int> regs;
-        while(line.find('$') != std::string::npos)
+        Job job = defaults;
+        job.inputPath = words[0];
+        job.outputPath = words[1];
+        for(unsigned int i = 2; i < words.size(); i++)
         {
-            int pos = line.find('$');
-            std::string reg = line.substr(pos, 3);
-            int len = reg == "$ze" ? 5 : 3; //special case for $zero which is only > 2 letter register
-            reg = line.substr(pos, len); //reparse reg incase it's $zero
-            line = line.substr(0, pos) + line.substr(pos+len);
-
-            //get the register value
-            int regNum = getRegNum(reg);
-            if(regNum < 0)
+            if(!parseOption(job, words[i]))
             {
-                std::cout << reg << " is not a valid register name\naborting\n";
-                return;
+                std::cout << "manifest line " << lineNum << ": unknown option: " << words[i] << "\n";
+                return 1;
 
             }
-            regs.push_back(regNum);
 
         }
 
-        //parse for immediate/offset/shamt
-        bool immediateSet = false;
-        int imm = 0;
+        jobs.push_back(job);
 
-        //we include - so we can have negatives
-        std::string numbers("-0123456789");
-        int posf = line.find_first_of(numbers);
-        int posl = line.find_last_of(numbers);
+    }
 
-        if(posf != std::string::npos)
-        {
-            immediateSet = true;
-            std::stringstream ss(line.substr(posf, posl+1));
-            ss >> imm;
+    //each job reports into its own log so the output can be printed in order
+    std::vector<std::stringstream> logs(jobs.size());
+    std::vector<WorkQueue> queues(workers);
+    for(unsigned int i = 0; i < jobs.size(); i++)
+    {
+        jobs[i].log = &logs[i];
+        queues[i % workers].jobs.push_back(i);
 
-        }
+    }
 
-        //calculate jump offset if applicable
-        if(instr.flag == Instruction::Jump)
-        {
-            line = trim(line);            
-            std::string labelName = line;
-            std::string alphanumeric("_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890");
-            int posl = line.find_last_not_of(alphanumeric);
-            if(posl != std::string::npos)
-            {
-                labelName = line.substr(posl+1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-            }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < workers; t++)
+    {
+        threads.push_back(std::thread(runWorker, std::ref(queues), t, std::ref(jobs)));
 
-            Label label = getLabel(labelName);
-            if(label.address < 0)
-            {
-                if(!immediateSet)
-                {
-                    std::cout << "label " << labelName << " does not exist\naborting\n";
-                    return;
+    }
 
-                }
-                else
-                {
-                    imm /= 4;
+    for(unsigned int t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
 
-                }
+    }
 
-            }
-            else
-            {
-                immediateSet = true;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-                //calculate the jump offset
-                if(instr.type == Instruction::I)
-                {
-                    int offset = label.address - pc;
-                    imm = offset;
+    //per file status then the totals
+    int failed = 0;
+    long bytesRead = 0;
+    long bytesWritten = 0;
+    for(unsigned int i = 0; i < jobs.size(); i++)
+    {
+        const Job& job = jobs[i];
+        std::cout << (job.ok ? "ok     " : "failed ") << job.inputPath << " -> " << job.outputPath;
+        std::cout << " (" << job.bytesRead << " -> " << job.bytesWritten << " bytes, " << job.seconds * 1000.0 << " ms)\n";
+        std::cout << logs[i].str();
 
-                    imm /= 4;
-                    if(imm > 0 || imm < 0)
-                    {
-                        imm -= 1;
+        failed += job.ok ? 0 : 1;
+        bytesRead += job.bytesRead;
+        bytesWritten += job.bytesWritten;
 
-                    }
+    }
 
-                    if(label.last)
-                        imm++;
+    double seconds = elapsed.count() > 0.0 ? elapsed.count() : 1e-9;
+    std::cout << jobs.size() << " files, " << failed << " failed, " << workers << " workers, " << seconds << " s\n";
+    std::cout << jobs.size() / seconds << " files/s, " << (bytesRead + bytesWritten) / seconds / (1024.0 * 1024.0) << " MB/s";
+    std::cout << " (" << bytesRead << " bytes read, " << bytesWritten << " bytes written)\n";
 
-                }
-                else if(instr.type == Instruction::J)
-                {
-                    imm = label.address;
-                    imm /= 4;
-                    if(label.last)
-                        imm++;
+    return failed > 0 ? 1 : 0;
 
-                }
+}
+
+void runWorker(std::vector<WorkQueue>& queues, int self, std::vector<Job>& jobs)
+{
+    while(true)
+    {
+        int next = -1;
 
+        //newest work from our own queue first
+        {
+            std::lock_guard<std::mutex> guard(queues[self].lock);
+            if(!queues[self].jobs.empty())
+            {
+                next = queues[self].jobs.back();
+                queues[self].jobs.pop_back();
 
             }
 
         }
 
-        if((instr.type == Instruction::I || instr.type == Instruction::J) && !immediateSet)
+        //otherwise steal the oldest work from someone else
+        for(unsigned int k = 1; next < 0 && k < queues.size(); k++)
         {
-            std::cout << "immediate/offset/label expected none found\naborting\n";
-            return;
-
-        }
+            WorkQueue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.jobs.empty())
+            {
+                next = victim.jobs.front();
+                victim.jobs.pop_front();
 
-        //an error occured while writing the instruction it will be printed out
-        if(!writeInstruction(instr, regs, imm, output))
-        {
-            return;
+            }
 
         }
 
-        pc += 0x000004;
-        lineNum++;
-
-    }
-
-}
-
-//this will only work for binary for now
-void disassembler(std::fstream& input, std::ofstream& output)
-{
-    std::string fullFile;
-    
-    //read the full file in
-
-    std::string line;
-    while(std::getline(input, line))
-    {
-        fullFile += line;
-
-    }
-
-    //read the input 32 characters at a time
-    while(fullFile.size() >= 32)
-    {
-        std::string bitstring = fullFile.substr(0, 32);
-        fullFile = fullFile.substr(32);
-
-        std::bitset<32> bitInstr(bitstring);
-        Instruction instr = getInstruction(bitInstr);
-
-        if(instr.type == Instruction::Error)
+        //no job adds new work so once everything is empty we are done
+        if(next < 0)
         {
-            std::cout << "instruction not supported by this disassembler.\n";
             return;
 
         }
 
-        writeInstruction(instr, bitInstr, output);
+        runJob(jobs[next]);
 
     }
 
@@ -0,0 +1,397 @@
+#ifndef DOVA_H
+#define DOVA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//libdova - the assembler/disassembler without any global mutable state
+//every call only touches what is passed to it so they can run on any number of threads
+//the instruction and register tables are constant data built by the compiler
+
+typedef struct Label
+{
+    std::string name;
+    int address;
+    bool last;
+    bool defined;
+    uint32_t hash;
+
+} Label;
+
+//a branch or jump waiting on a label that has no address yet
+typedef struct Fixup
+{
+    unsigned int word;
+    int pc;
+    int label;
+
+} Fixup;
+
+typedef struct SymbolStats
+{
+    size_t labels;
+    size_t slots;
+    unsigned long lookups;
+    unsigned long probes;
+
+} SymbolStats;
+
+//counters and per phase timings of a run
+//the clock is only read when timing is asked for, with several threads the times are summed
+typedef struct RunStats
+{
+    double readSeconds;
+    double labelSeconds;
+    double lexSeconds;
+    double lookupSeconds;
+    double encodeSeconds;
+    double outputSeconds;
+
+    unsigned long lines;
+    unsigned long rTypes;
+    unsigned long iTypes;
+    unsigned long jTypes;
+    unsigned long labels;
+    unsigned long fixups;
+
+    //incremental assembly only
+    unsigned long regions;
+    unsigned long reusedRegions;
+
+    //the library leaves these to whoever does the reading and writing
+    long bytesRead;
+    long bytesWritten;
+    unsigned long allocations;
+    unsigned long allocatedBytes;
+    long peakRssKb;
+
+} RunStats;
+
+RunStats makeRunStats();
+void addRunStats(RunStats& total, const RunStats& part);
+
+typedef struct AssembleResult
+{
+    bool ok;
+    std::vector<uint32_t> words;
+
+    //every label in definition order with its address, for symbol tables
+    std::vector<Label> labels;
+
+    //each one is the full message as the command line tool prints it
+    std::vector<std::string> diagnostics;
+
+    SymbolStats symbols;
+    RunStats stats;
+
+} AssembleResult;
+
+//the state of one assembly fed a line at a time
+typedef struct Assembly
+{
+    int pc;
+    int lineNum;
+    bool failed;
+
+    //every instruction is encoded once into here, forward references are
+    //patched through the fixups once their label has an address
+    std::vector<uint32_t> words;
+    std::vector<Fixup> fixups;
+
+    //how many words takeWords has handed out, words[0] is the word after them
+    size_t wordBase;
+    std::vector<int> pendingLabels;
+
+    //labels in definition order, each name is stored once here
+    std::vector<Label> labels;
+
+    //open addressing table of indices into labels, -1 marks an empty slot
+    //the capacity is always a power of two and kept at most half full
+    std::vector<int> labelSlots;
+    unsigned long labelLookups;
+    unsigned long labelProbes;
+
+    std::vector<std::string> diagnostics;
+
+    bool timing;
+    RunStats stats;
+
+} Assembly;
+
+Assembly makeAssembly(bool timing = false);
+bool assembleLine(Assembly& assembly, std::string_view line);
+AssembleResult finishAssembly(Assembly& assembly);
+
+//for streaming: appends the words at the front that no fixup is still waiting to patch to out
+//and drops them from the assembly, so it only holds the words from the oldest reference to a
+//label that has no address yet. finishAssembly then only returns the words not taken
+void takeWords(Assembly& assembly, std::vector<uint32_t>& out);
+
+//threads > 1 splits the source into chunks that are assembled in parallel
+//the words are the same either way
+AssembleResult assemble(std::string_view source, int threads = 1, bool timing = false);
+
+//one piece of source cut at a label definition. encodeRegion leaves the label operands out,
+//the incremental assembler fills them in and keeps them for the layout it last placed the region in
+typedef struct Region
+{
+    //hash of the line hashes of the text, and the text itself which has to match
+    //as well before the region is reused so a hash collision can't pick the wrong words
+    uint64_t hash;
+    std::string text;
+    int lines;
+
+    //instructions of each type, added to the stats when the region is reused
+    unsigned long rTypes;
+    unsigned long iTypes;
+    unsigned long jTypes;
+
+    std::vector<uint32_t> words;
+
+    //labels defined in the region with the word they point at, counted from the start of the region
+    std::vector<std::string> labelNames;
+    std::vector<int> labelWords;
+
+    //words that need a label operand filled in and the address each one was filled in with, +1
+    //for a label at the end of code and -1 before it has been. the incremental assembler keeps
+    //them sorted by that address so the operands that can point at a moved label come last
+    std::vector<int> relocWords;
+    std::vector<std::string> relocLabels;
+    std::vector<int> relocTargets;
+
+    //the word the region started at when its operands were filled in, -1 if they haven't been,
+    //and how many of them point forward like the fixups of assemble()
+    int base;
+    unsigned long fixups;
+
+} Region;
+
+//encoded regions looked up by the hash of their text
+typedef struct RegionCache
+{
+    //in the order of the last assembly
+    std::vector<Region> regions;
+
+    //open addressing table of indices into regions, -1 marks an empty slot
+    std::vector<int> slots;
+
+    //the labels of the regions where that assembly placed them, only the labels of
+    //regions that changed or moved are placed again
+    Assembly symbols;
+
+} RegionCache;
+
+//assembles source re-encoding only the regions the cache does not already have, then leaves the
+//cache holding the regions of this source. regions that didn't change or move keep their layout and
+//only label operands whose label moved are filled in again. the result is the same as assemble() gives
+AssembleResult assembleIncremental(std::string_view source, RegionCache& cache, bool timing = false);
+
+//the cache as bytes and back, a cache that does not read back cleanly comes out empty
+void saveRegionCache(const RegionCache& cache, std::string& out);
+bool loadRegionCache(RegionCache& cache, const char* data, size_t size);
+
+//one module assembled on its own with its label operands left for the linker
+typedef struct ObjectModule
+{
+    typedef enum Reloc
+    {
+        Branch, Jump
+
+    } Reloc;
+
+    std::vector<uint32_t> words;
+
+    //every label the module defines or refers to, exported ones have the word they
+    //point at counted from the start of the module and imported ones have -1
+    std::vector<std::string> symbols;
+    std::vector<int> symbolWords;
+
+    //words that need a label operand filled in, with the symbol and how it is encoded
+    std::vector<int> relocWords;
+    std::vector<int> relocSymbols;
+    std::vector<Reloc> relocKinds;
+
+} ObjectModule;
+
+typedef struct ObjectResult
+{
+    bool ok;
+    ObjectModule module;
+    std::vector<std::string> diagnostics;
+    RunStats stats;
+
+} ObjectResult;
+
+//labels that are not defined in the source become imports instead of an error
+ObjectResult assembleObject(std::string_view source, bool timing = false);
+
+//the module as bytes and back, loadObject checks every index so a bad file is rejected whole
+void saveObject(const ObjectModule& module, std::string& out);
+bool loadObject(ObjectModule& module, const char* data, size_t size);
+
+//lays the modules out one after another from 0x00400000 and fills in every relocation
+//through one global symbol table. the words are the same as assembling the sources joined together
+AssembleResult link(const std::vector<ObjectModule>& modules, bool timing = false);
+
+typedef struct DisassembleResult
+{
+    bool ok;
+
+    //everything up to the first unsupported word, which is at badWord (-1 if there is none)
+    std::string text;
+    long badWord;
+
+    std::vector<std::string> diagnostics;
+    RunStats stats;
+
+} DisassembleResult;
+
+//threads > 1 splits the words into shards that are formatted on their own threads and joined
+//in order, the text and the diagnostics are the same either way
+DisassembleResult disassemble(const uint32_t* words, size_t count, int threads = 1, bool timing = false);
+DisassembleResult disassemble(const std::vector<uint32_t>& words, int threads = 1, bool timing = false);
+
+//two passes: the first marks every word a branch or jump lands on, the second puts a label like
+//L_00400010 in front of each of them and uses it as the operand. operands that would not assemble
+//back to the same word, or that point outside the code, stay numbers
+DisassembleResult disassembleLabeled(const uint32_t* words, size_t count, int threads = 1, bool timing = false);
+DisassembleResult disassembleLabeled(const std::vector<uint32_t>& words, int threads = 1, bool timing = false);
+
+//the diagnostic for an unsupported word, index counts words from the start of the input
+std::string unsupportedWord(size_t index, uint32_t word);
+
+//appends one line of assembly for word, false if the instruction is not supported
+bool disassembleWord(uint32_t word, std::string& text);
+bool disassembleWord(uint32_t word, std::string& text, RunStats& stats, bool timing);
+
+//how encoded words are written out
+typedef struct OutputFormat
+{
+    bool hex;
+    bool binary;
+    bool programCounter;
+
+    //raw images start with 0x7f 'D' 'V' followed by 'L' or 'B' for the word byte order
+    //the words follow directly, 4 bytes each
+    bool raw;
+    bool bigEndian;
+
+    //an elf32 mips executable written with formatElf, bigEndian picks the byte order
+    bool elf;
+
+} OutputFormat;
+
+OutputFormat makeOutputFormat();
+void formatHeader(const OutputFormat& format, std::string& out);
+void formatWord(const OutputFormat& format, uint32_t word, int pc, std::string& out);
+
+//formats count words starting at address pc, the same as calling formatWord on each
+void formatWords(const OutputFormat& format, const uint32_t* words, size_t count, int pc, std::string& out);
+
+//the same into memory the caller sized with formatSize, returns the end of what was written
+char* formatWords(const OutputFormat& format, const uint32_t* words, size_t count, int pc, char* out);
+
+//how many bytes formatting count words takes, every line of a format is the same length
+size_t formatSize(const OutputFormat& format, size_t count);
+
+//an executable with the words as .text at 0x00400000 in one loadable segment, a symbol for every
+//label and the entry point at main if there is one, otherwise at the first word
+void formatElf(const OutputFormat& format, const std::vector<uint32_t>& words, const std::vector<Label>& labels, std::string& out);
+
+//turns a text (ascii 0/1), raw or elf image into words a piece at a time
+//the format is detected from the first bytes
+typedef struct ImageReader
+{
+    enum Format
+    {
+        Unknown, Text, Raw, Elf
+
+    } format;
+
+    bool bigEndian;
+    char header[4];
+    int headerSize;
+
+    //the word being built and how many bits (text) or bytes (raw) are in it
+    uint32_t word;
+    int count;
+
+    //elf headers are kept until the program headers are in, after that only
+    //the bytes of the executable segment are turned into words
+    std::string elfHeaders;
+    bool elfReady;
+    uint32_t entry;
+    size_t offset;
+    size_t textBegin;
+    size_t textEnd;
+
+} ImageReader;
+
+ImageReader makeImageReader();
+bool readImage(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words, std::string& error);
+bool finishImage(const ImageReader& reader, std::string& error);
+
+//assembles source, disassembles the words (plainly and with labels), assembles that text again
+//and compares the words, all in memory. the words also go out and back in through the text,
+//raw and elf images in both byte orders. badWord is the first word that came back different
+typedef struct VerifyResult
+{
+    bool ok;
+    size_t words;
+    long badWord;
+
+    std::vector<std::string> diagnostics;
+
+} VerifyResult;
+
+VerifyResult verifyRoundTrip(std::string_view source, int threads = 1);
+
+//checks encode and decode against each other on random words, half of them valid instructions
+//built from the instruction table and half any 32 bits at all. a supported word has to disassemble
+//to a line that assembles back to it with the bits the instruction does not use cleared, an
+//unsupported one must not be in the instruction table. the same seed always runs the same cases
+typedef struct FuzzResult
+{
+    bool ok;
+    unsigned long cases;
+    unsigned long failures;
+    double seconds;
+
+    //the first few failures, each with the word and the line it turned into
+    std::vector<std::string> diagnostics;
+
+} FuzzResult;
+
+FuzzResult fuzz(unsigned long cases, uint64_t seed, int threads = 1);
+
+//runs words loaded at 0x00400000 from the word at entry, with no delay slots. the run ends
+//normally when the pc leaves the code (jr $ra from main or a jump to a label at the end), or
+//on a fault (overflow, unaligned access, unsupported word) or after maxSteps instructions
+typedef struct SimResult
+{
+    bool ok;
+    unsigned long steps;
+    double seconds;
+
+    //where the run stopped and the registers at that point
+    uint32_t pc;
+    uint32_t regs[32];
+
+    std::vector<std::string> diagnostics;
+
+} SimResult;
+
+SimResult simulate(const std::vector<uint32_t>& words, uint32_t entry, unsigned long maxSteps);
+
+//the name the disassembler uses for register num, like $t0
+std::string_view registerName(int num);
+
+//the template of every instruction the assembler takes in table order, like lw $rt, offset($rs),
+//and an empty one past the end. the immediate is written as shamt, imm, offset (a byte offset
+//for lw/sw, a branch offset for beq/bne) or target
+std::string_view instructionSyntax(size_t index);
+
+#endif
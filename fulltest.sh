@@ -4,4 +4,12 @@ cd "$(dirname "$0")"
 ./dova a.out b.asm -d
 ./dova b.asm b.out
 diff a.out b.out > diff.txt
+./dova tests/allinstructions.asm a.img -r
+./dova a.img c.asm -d
+./dova c.asm c.out
+diff a.out c.out >> diff.txt
+./dova tests/allinstructions.asm a.elf -e --big-endian
+./dova a.elf d.asm -d
+./dova d.asm d.out
+diff a.out d.out >> diff.txt
 cat diff.txt
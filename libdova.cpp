@@ -0,0 +1,4800 @@
+#include "dova.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+//the text image parser has sse2/avx2 versions picked at runtime on x86
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DOVA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+//the most any template has, lw $rt, offset($rs) has 6
+const int maxOperands = 6;
+
+//a literal type so the whole table below is built by the compiler
+typedef struct Instruction
+{
+    typedef enum Type
+    {
+        R, I, J, Error
+
+    } Type;
+
+    std::string_view opname;
+
+    //the template the instruction was made from, like lw $rt, offset($rs)
+    std::string_view syntax;
+
+    int opcode;
+    int funct;
+    Type type;
+
+    typedef enum RegType
+    {
+        rs, rt, rd
+
+    } RegType;
+
+    RegType regOrder[3];
+    int regCount;
+
+    typedef enum Flag
+    {
+        None, Jump, Offset
+
+    } Flag;
+
+    Flag flag;
+
+    //what follows the opname in source order, every line is checked against this
+    typedef enum Operand
+    {
+        Register, Immediate, Comma, LeftParen, RightParen
+
+    } Operand;
+
+    Operand operands[maxOperands];
+    int operandCount;
+
+} Instruction;
+
+constexpr Instruction makeInstruction(std::string_view line, Instruction::Type type, int opcode);
+constexpr Instruction makeRType(std::string_view line, int opcode, int funct);
+constexpr Instruction makeIType(std::string_view line, int opcode, Instruction::Flag flag = Instruction::None);
+constexpr Instruction makeJType(std::string_view line, int opcode);
+
+//decode tables derived from the instruction table, each slot holds an index into it or -1
+//indexed by opcode, and by funct for opcode 0 (SPECIAL)
+typedef struct DecodeTables
+{
+    int8_t opcode[64];
+    int8_t funct[64];
+
+    //false if two instructions would decode from the same slot
+    bool unique;
+
+} DecodeTables;
+
+constexpr DecodeTables makeDecodeTables();
+constexpr bool checkInstructions();
+
+const Instruction& getInstruction(std::string_view opname);
+const Instruction& getInstruction(uint32_t word);
+
+uint32_t encodeInstruction(const Instruction& instr, const int* regs, int num);
+void writeInstruction(const Instruction& instr, uint32_t word, std::string& out);
+
+//register names in number order as the disassembler writes them, followed by the
+//other names the assembler takes for them
+constexpr std::string_view registerNames[] =
+{
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra",
+    "$s8"
+
+};
+
+//the register each of the other names stands for
+constexpr int aliasNumbers[] = { 30 };
+
+//a perfect hash over a fixed set of names: the seed is searched for at compile time until every
+//name gets a slot to itself, so a lookup is one hash, one load and one compare
+const int nameSlotBits = 7;
+const int nameSlots = 1 << nameSlotBits;
+
+typedef struct NameHash
+{
+    uint32_t seed;
+    bool found;
+
+    //index of the name in each slot, -1 marks an empty one
+    int8_t slots[nameSlots];
+
+} NameHash;
+
+constexpr int hashSlot(std::string_view name, uint32_t seed);
+constexpr NameHash makeNameHash(std::string_view (*nameAt)(int), int count);
+constexpr std::string_view mnemonicAt(int index);
+constexpr std::string_view registerAt(int index);
+
+int getRegNum(std::string_view reg);
+std::string_view getRegName(int num);
+
+//laps time into the phases of a RunStats, the clock is never read when it is off
+typedef struct PhaseClock
+{
+    bool on;
+    std::chrono::steady_clock::time_point last;
+
+} PhaseClock;
+
+PhaseClock startClock(bool on);
+void lap(PhaseClock& clock, double& seconds);
+
+//one piece of a source line, the text points into the line so nothing is copied
+typedef struct Token
+{
+    typedef enum Kind
+    {
+        Mnemonic, Register, Integer, Label, Comma, LeftParen, RightParen, Colon, Comment, Invalid
+
+    } Kind;
+
+    Kind kind;
+    std::string_view text;
+
+    //only set for integers
+    int value;
+
+} Token;
+
+//more than any instruction needs, anything past this is an error anyway
+const int maxTokens = 16;
+
+//a lexed source line with its label definition split off
+typedef struct SourceLine
+{
+    Token tokens[maxTokens];
+    int count;
+
+    //the tokens of the instruction start at code, empty lines have none
+    int code;
+    std::string_view label;
+
+} SourceLine;
+
+int tokenize(std::string_view line, Token* tokens, int max);
+bool isWordChar(char c);
+Token makeWord(std::string_view text, bool mnemonic);
+
+
+Label makeLabel(std::string_view name, uint32_t hash);
+
+uint32_t hashName(std::string_view name);
+Label* internLabel(Assembly& assembly, std::string_view name);
+const Label* getLabel(const Assembly& assembly, std::string_view name, unsigned long& probes);
+void growLabelSlots(Assembly& assembly);
+
+//one line aligned piece of the source for the parallel assembler
+typedef struct SourceChunk
+{
+    const char* begin;
+    const char* end;
+
+    //filled in by the label scan, the bases come from a prefix sum over the chunks
+    int lines;
+    int words;
+    int lineBase;
+    int wordBase;
+
+    //labels defined in the chunk with the chunk local word they point at
+    std::vector<std::string_view> labelNames;
+    std::vector<int> labelWords;
+    std::vector<int> labelLines;
+
+    //first error in the chunk by line number, and the first missing label
+    int errorLine;
+    std::string error;
+    int missingLine;
+    std::string missing;
+
+    unsigned long lookups;
+    unsigned long probes;
+
+    bool timing;
+    RunStats stats;
+
+} SourceChunk;
+
+int labelImmediate(const Instruction& instr, const Label& label, int pc);
+uint32_t resolveLabel(uint32_t word, const Label& label, int pc);
+bool splitLabel(std::string_view line, SourceLine& source, std::string& error);
+bool encodeLine(const SourceLine& source, int lineNum, std::string_view fullLine, uint32_t& word, std::string_view& labelName, std::string& error, RunStats& stats, PhaseClock& clock);
+std::string syntaxError(int lineNum, std::string_view fullLine, std::string_view reason);
+
+AssembleResult parallelAssemble(std::string_view source, int threads, bool timing);
+void scanChunk(SourceChunk& chunk);
+void encodeChunk(const Assembly& assembly, SourceChunk& chunk, std::vector<uint32_t>& words);
+SymbolStats symbolStats(const Assembly& assembly);
+
+//longest run of lines one region gets
+const int regionMaxLines = 4096;
+
+bool definesLabel(std::string_view line);
+bool startsRegion(std::string_view line, uint64_t hash);
+size_t nextRegion(std::string_view source, size_t start, uint64_t& hash);
+uint64_t hashLine(std::string_view line);
+bool encodeRegion(std::string_view text, Region& region, std::string& error, RunStats& stats, PhaseClock& clock);
+int findRegion(const RegionCache& cache, uint64_t hash, std::string_view text, const std::vector<bool>& taken);
+void indexRegions(RegionCache& cache);
+int labelTarget(const Label& label, int endPc);
+bool pointsForward(int target, int pc);
+void sortRelocations(Region& region);
+
+void appendU32(std::string& out, uint32_t value);
+void appendText(std::string& out, const std::string& text);
+bool readU32(const char*& cursor, const char* end, uint32_t& value);
+bool readText(const char*& cursor, const char* end, std::string& text);
+
+//the text of every byte in binary and in hex, built at compile time
+typedef struct TextTables
+{
+    char binary[256][8];
+    char hex[256][2];
+
+} TextTables;
+
+constexpr TextTables makeTextTables();
+char* writeHex(uint32_t value, char* out);
+char* writeBinary(uint32_t value, char* out);
+char* writeLine(const OutputFormat& format, uint32_t word, uint32_t pc, char* out);
+
+//the segment starts on its own page in the file, and the headers a reader keeps are capped
+const uint32_t elfPageSize = 0x1000;
+const size_t elfHeaderLimit = 64 * 1024;
+
+void appendElf16(std::string& out, uint32_t value, bool bigEndian);
+void appendElf32(std::string& out, uint32_t value, bool bigEndian);
+uint32_t readElf16(const char* data, bool bigEndian);
+uint32_t readElf32(const char* data, bool bigEndian);
+
+//a run of words formatted by one thread of parallelDisassemble
+typedef struct DisassemblyShard
+{
+    size_t begin;
+    size_t end;
+    std::string text;
+    long badWord;
+    RunStats stats;
+
+} DisassemblyShard;
+
+DisassembleResult disassembleWords(const uint32_t* words, size_t count, int threads, const std::vector<uint64_t>* targets, bool timing);
+DisassembleResult parallelDisassemble(const uint32_t* words, size_t count, int threads, const std::vector<uint64_t>* targets, bool timing);
+
+//labelled disassembly: the word index a branch or jump goes to, or -1 when its operand stays a number
+long labelTarget(uint32_t word, size_t index, size_t count);
+bool disassembleAt(const uint32_t* words, size_t count, size_t index, const std::vector<uint64_t>* targets, std::string& text, RunStats& stats, bool timing);
+void writeLabel(size_t index, std::string& out);
+void writeLabeledInstruction(const Instruction& instr, uint32_t word, size_t target, std::string& out);
+
+//verifier and fuzzer
+const size_t fuzzReportLimit = 16;
+
+uint32_t operandBits(const Instruction& instr);
+bool imageRoundTrip(const OutputFormat& format, const AssembleResult& assembled, std::vector<uint32_t>& words, std::string& error);
+long firstDifference(const std::vector<uint32_t>& expected, const std::vector<uint32_t>& words);
+bool reassembles(const AssembleResult& assembled, const std::string& text, std::string_view pass, int threads, VerifyResult& result);
+uint64_t nextRandom(uint64_t& state);
+bool checkWord(uint32_t word, std::string& text, SourceLine& source, std::string& failure);
+
+//one instruction decoded for the simulator, registers and immediates are pulled out once
+//and branches and jumps already hold the index of the word they go to
+typedef struct SimOp
+{
+    typedef enum Code
+    {
+        Add, Sub, And, Or, Nor, Slt, Sll, Srl, Jr, Addi, Andi, Ori, Beq, Bne, Lw, Sw, J, Jal, Invalid
+
+    } Code;
+
+    Code code;
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t rd;
+    uint8_t shamt;
+    int32_t imm;
+
+} SimOp;
+
+//sparse memory: the top 10 bits of an address pick a table, the next 10 a page of 1024 words
+//tables and pages are made on the first store, loads from anywhere never stored to read 0
+typedef struct SimMemory
+{
+    int directory[1024];
+    std::vector<int> tables;
+    std::vector<uint32_t> pages;
+
+} SimMemory;
+
+typedef enum SimFault
+{
+    NoFault, Overflow, UnalignedJump, UnalignedAccess, Unsupported, StepLimit
+
+} SimFault;
+
+SimMemory makeSimMemory();
+uint32_t loadWord(const SimMemory& memory, uint32_t address);
+void storeWord(SimMemory& memory, uint32_t address, uint32_t value);
+SimOp decodeForRun(uint32_t word, int index);
+std::string simFaultText(SimFault fault, uint32_t value, uint32_t pc, unsigned long maxSteps);
+
+void readRawBytes(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words);
+bool readElfHeaders(ImageReader& reader, std::string& error);
+void readElfBytes(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words);
+bool readElf(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words, std::string& error);
+
+//parses lines of exactly 32 binary digits for as long as the input sticks to that,
+//returns how many bytes were used and leaves anything else to the careful loop in readImage
+typedef size_t (*BitLineParser)(const char* data, size_t size, std::vector<uint32_t>& words);
+
+BitLineParser pickBitLineParser();
+size_t skipNewline(const char* data, size_t size, size_t i);
+size_t parseBitLinesScalar(const char* data, size_t size, std::vector<uint32_t>& words);
+#ifdef DOVA_X86_SIMD
+size_t parseBitLinesSse2(const char* data, size_t size, std::vector<uint32_t>& words);
+size_t parseBitLinesAvx2(const char* data, size_t size, std::vector<uint32_t>& words);
+#endif
+
+bool isWordChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+
+}
+
+Token makeWord(std::string_view text, bool mnemonic)
+{
+    Token token;
+    token.text = text;
+    token.value = 0;
+
+    //anything that does not start like a number is a name
+    if(text[0] != '-' && (text[0] < '0' || text[0] > '9'))
+    {
+        token.kind = mnemonic ? Token::Mnemonic : Token::Label;
+        return token;
+
+    }
+
+    //decimal or 0x hex with an optional -, the whole word has to be used up
+    bool negative = text[0] == '-';
+    size_t i = negative ? 1 : 0;
+    int base = 10;
+    if(text.size() > i + 2 && text[i] == '0' && (text[i+1] == 'x' || text[i+1] == 'X'))
+    {
+        base = 16;
+        i += 2;
+
+    }
+
+    uint32_t value = 0;
+    for(; i < text.size(); i++)
+    {
+        char c = text[i];
+        int digit = 16;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+
+        if(digit >= base)
+        {
+            token.kind = Token::Invalid;
+            return token;
+
+        }
+
+        value = value * base + digit;
+
+    }
+
+    token.kind = Token::Integer;
+    token.value = (int)(negative ? 0u - value : value);
+    return token;
+
+}
+
+int tokenize(std::string_view line, Token* tokens, int max)
+{
+    int count = 0;
+    bool mnemonic = true;
+
+    size_t i = 0;
+    while(i < line.size() && count < max)
+    {
+        char c = line[i];
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v')
+        {
+            i++;
+            continue;
+
+        }
+
+        Token& token = tokens[count++];
+        token.value = 0;
+        size_t start = i++;
+
+        if(c == '#')
+        {
+            //the rest of the line
+            token.kind = Token::Comment;
+            token.text = line.substr(start);
+            break;
+
+        }
+        else if(c == '$')
+        {
+            while(i < line.size() && isWordChar(line[i]))
+            {
+                i++;
+
+            }
+
+            token.kind = Token::Register;
+            token.text = line.substr(start, i - start);
+
+        }
+        else if(isWordChar(c) || (c == '-' && i < line.size() && line[i] >= '0' && line[i] <= '9'))
+        {
+            while(i < line.size() && isWordChar(line[i]))
+            {
+                i++;
+
+            }
+
+            token = makeWord(line.substr(start, i - start), mnemonic);
+            mnemonic = mnemonic && token.kind != Token::Mnemonic;
+
+        }
+        else
+        {
+            token.text = line.substr(start, 1);
+            if(c == ',')
+                token.kind = Token::Comma;
+            else if(c == '(')
+                token.kind = Token::LeftParen;
+            else if(c == ')')
+                token.kind = Token::RightParen;
+            else if(c == ':')
+                token.kind = Token::Colon;
+            else
+                token.kind = Token::Invalid;
+
+            //a word right before a colon was a label definition, the mnemonic comes after it
+            if(token.kind == Token::Colon && count == 2 && tokens[0].kind == Token::Mnemonic)
+            {
+                tokens[0].kind = Token::Label;
+                mnemonic = true;
+
+            }
+
+        }
+
+    }
+
+    return count;
+
+}
+
+constexpr Instruction makeInstruction(std::string_view line, Instruction::Type type, int opcode)
+{
+    Instruction instr = {};
+    instr.syntax = line;
+    instr.opcode = opcode;
+    instr.funct = 0;
+    instr.type = type;
+    instr.flag = Instruction::None;
+
+    size_t i = line.find(' ');
+    instr.opname = line.substr(0, i);
+
+    while(i < line.size())
+    {
+        char c = line[i++];
+        if(c == ' ')
+        {
+            continue;
+
+        }
+
+        Instruction::Operand operand = Instruction::Immediate; //imm, offset, shamt or target
+        if(c == '$')
+        {
+            //we only accept $rs, $rt and $rd here
+            std::string_view reg = line.substr(i, 2);
+            if(reg == "rs")
+                instr.regOrder[instr.regCount++] = Instruction::rs;
+            else if(reg == "rt")
+                instr.regOrder[instr.regCount++] = Instruction::rt;
+            else if(reg == "rd")
+                instr.regOrder[instr.regCount++] = Instruction::rd;
+
+            operand = Instruction::Register;
+            i += 2;
+
+        }
+        else if(c == ',')
+            operand = Instruction::Comma;
+        else if(c == '(')
+            operand = Instruction::LeftParen;
+        else if(c == ')')
+            operand = Instruction::RightParen;
+        else
+        {
+            while(i < line.size() && line[i] >= 'a' && line[i] <= 'z')
+            {
+                i++;
+
+            }
+
+        }
+
+        instr.operands[instr.operandCount++] = operand;
+
+    }
+
+    return instr;
+
+}
+
+constexpr Instruction makeRType(std::string_view line, int opcode, int funct)
+{
+    Instruction instr = makeInstruction(line, Instruction::R, opcode);
+    instr.funct = funct; //assign the function
+
+    return instr;
+
+}
+
+constexpr Instruction makeIType(std::string_view line, int opcode, Instruction::Flag flag)
+{
+    Instruction instr = makeInstruction(line, Instruction::I, opcode);
+    instr.flag = flag; //assign a special function
+
+    return instr;
+
+}
+
+constexpr Instruction makeJType(std::string_view line, int opcode)
+{
+    Instruction instr = makeInstruction(line, Instruction::J, opcode);
+    instr.flag = Instruction::Jump;
+
+    return instr;
+
+}
+
+//the templates are taken apart by the compiler, nothing here runs at startup
+constexpr Instruction instructions[] =
+{
+    //rtype instructions
+    makeRType("add $rd, $rs, $rt", 0x0, 0x20),
+    makeRType("sub $rd, $rs, $rt", 0x0, 0x22),
+    makeRType("and $rd, $rs, $rt", 0x0, 0x24),
+    makeRType("or $rd, $rs, $rt", 0x0, 0x25),
+    makeRType("nor $rd, $rs, $rt", 0x0, 0x27),
+    makeRType("slt $rd, $rs, $rt", 0x0, 0x2a),
+    makeRType("sll $rd, $rt, shamt", 0x0, 0x0),
+    makeRType("srl $rd, $rt, shamt", 0x0, 0x2),
+    makeRType("jr $rs", 0x0, 0x8),
+
+    //itype instructions
+    makeIType("addi $rt, $rs, imm", 0x8),
+    makeIType("andi $rt, $rs, imm", 0xc),
+    makeIType("ori $rt, $rs, imm", 0xd),
+    makeIType("beq $rs, $rt, offset", 0x4, Instruction::Jump),
+    makeIType("bne $rs, $rt, offset", 0x5, Instruction::Jump),
+    makeIType("lw $rt, offset($rs)", 0x23, Instruction::Offset),
+    makeIType("sw $rt, offset($rs)", 0x2b, Instruction::Offset),
+
+    //j type instructions
+    makeJType("j target", 0x2),
+    makeJType("jal target", 0x3)
+
+};
+
+constexpr int instructionCount = sizeof(instructions) / sizeof(instructions[0]);
+
+//what lookups hand back for anything not in the table
+constexpr Instruction errorInstruction = { "", "", 0, 0, Instruction::Error, {}, 0, Instruction::None, {}, 0 };
+
+constexpr DecodeTables makeDecodeTables()
+{
+    DecodeTables tables = {};
+    tables.unique = true;
+
+    for(int i = 0; i < 64; i++)
+    {
+        tables.opcode[i] = -1;
+        tables.funct[i] = -1;
+
+    }
+
+    for(int i = 0; i < instructionCount; i++)
+    {
+        const Instruction& instr = instructions[i];
+        int8_t& slot = instr.opcode == 0 ? tables.funct[instr.funct & 0x3f] : tables.opcode[instr.opcode & 0x3f];
+
+        tables.unique = tables.unique && slot < 0;
+        slot = i;
+
+    }
+
+    return tables;
+
+}
+
+constexpr DecodeTables decodeTables = makeDecodeTables();
+
+//every template has to be something encodeLine, encodeInstruction and writeInstruction all handle
+constexpr bool checkInstructions()
+{
+    for(int i = 0; i < instructionCount; i++)
+    {
+        const Instruction& instr = instructions[i];
+        const Instruction::Operand* operands = instr.operands;
+        int count = instr.operandCount;
+
+        if(instr.opname.empty() || instr.opcode < 0 || instr.opcode > 0x3f || instr.funct < 0 || instr.funct > 0x3f)
+            return false;
+
+        //SPECIAL is the only opcode with a funct
+        if((instr.type == Instruction::R) != (instr.opcode == 0))
+            return false;
+
+        int registers = 0;
+        int immediates = 0;
+        for(int k = 0; k < count; k++)
+        {
+            registers += operands[k] == Instruction::Register;
+            immediates += operands[k] == Instruction::Immediate;
+
+        }
+
+        if(count == 0 || registers != instr.regCount || immediates > 1)
+            return false;
+
+        //commas go between operands, an offset is the one place a ( and ) are
+        bool offset = count >= 4 && operands[count-4] == Instruction::Immediate && operands[count-3] == Instruction::LeftParen &&
+                      operands[count-2] == Instruction::Register && operands[count-1] == Instruction::RightParen;
+
+        int end = offset ? count - 3 : count;
+        for(int k = 0; k < end; k++)
+        {
+            if((operands[k] == Instruction::Comma) != (k % 2 == 1))
+                return false;
+
+        }
+
+        if(end % 2 == 0 || (instr.flag == Instruction::Offset) != offset)
+            return false;
+
+        //writeInstruction puts the immediate last, or in front of the ( of an offset
+        if(immediates > 0 && !offset && operands[count-1] != Instruction::Immediate)
+            return false;
+
+        if(instr.type == Instruction::I && immediates != 1)
+            return false;
+
+        if(instr.type == Instruction::J && (instr.regCount != 0 || count != 1 || instr.flag != Instruction::Jump))
+            return false;
+
+        //every instruction decodes back to itself
+        int slot = instr.opcode == 0 ? decodeTables.funct[instr.funct] : decodeTables.opcode[instr.opcode];
+        if(slot != i)
+            return false;
+
+        for(int k = 0; k < i; k++)
+        {
+            if(instructions[k].opname == instr.opname)
+                return false;
+
+        }
+
+    }
+
+    return true;
+
+}
+
+static_assert(decodeTables.unique, "two instructions decode from the same opcode or funct");
+static_assert(checkInstructions(), "the instruction table does not match what the assembler and disassembler expect");
+
+constexpr int hashSlot(std::string_view name, uint32_t seed)
+{
+    //fnv-1a started from the seed, the last character barely reaches the top bits
+    //so they are mixed once more before picking the slot
+    uint32_t hash = seed;
+    for(size_t i = 0; i < name.size(); i++)
+    {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+
+    }
+
+    hash ^= hash >> 15;
+    return (hash * 0x9e3779b9u) >> (32 - nameSlotBits);
+
+}
+
+constexpr NameHash makeNameHash(std::string_view (*nameAt)(int), int count)
+{
+    NameHash table = {};
+
+    for(uint32_t attempt = 0; attempt < 4096 && !table.found; attempt++)
+    {
+        table.seed = 2166136261u + attempt * 0x9e3779b9u;
+        table.found = true;
+
+        for(int i = 0; i < nameSlots; i++)
+        {
+            table.slots[i] = -1;
+
+        }
+
+        for(int i = 0; i < count && table.found; i++)
+        {
+            int8_t& slot = table.slots[hashSlot(nameAt(i), table.seed)];
+            table.found = slot < 0;
+            slot = i;
+
+        }
+
+    }
+
+    return table;
+
+}
+
+constexpr std::string_view mnemonicAt(int index)
+{
+    return instructions[index].opname;
+
+}
+
+constexpr std::string_view registerAt(int index)
+{
+    return registerNames[index];
+
+}
+
+constexpr int registerCount = sizeof(registerNames) / sizeof(registerNames[0]);
+
+constexpr NameHash mnemonicHash = makeNameHash(mnemonicAt, instructionCount);
+constexpr NameHash registerHash = makeNameHash(registerAt, registerCount);
+
+static_assert(mnemonicHash.found && registerHash.found, "no perfect hash seed found for the mnemonics or registers");
+static_assert(registerCount == 32 + sizeof(aliasNumbers) / sizeof(aliasNumbers[0]), "every register alias needs a number");
+
+const Instruction& getInstruction(std::string_view opname)
+{
+    int slot = mnemonicHash.slots[hashSlot(opname, mnemonicHash.seed)];
+
+    if(slot < 0 || instructions[slot].opname != opname)
+    {
+        return errorInstruction;
+
+    }
+
+    return instructions[slot];
+
+}
+
+const Instruction& getInstruction(uint32_t word)
+{
+    //the opcode is the top 6 bits, SPECIAL instructions use the funct in the bottom 6
+    uint32_t opcode = word >> 26;
+    int slot = opcode == 0 ? decodeTables.funct[word & 0x3f] : decodeTables.opcode[opcode];
+
+    if(slot < 0)
+    {
+        return errorInstruction;
+
+    }
+
+    return instructions[slot];
+
+}
+
+uint32_t encodeInstruction(const Instruction& instr, const int* regs, int num)
+{
+    //the opcode is always the top 6 bits
+    uint32_t word = (uint32_t)(instr.opcode & 0x3f) << 26;
+
+    if(instr.type == Instruction::J)
+    {
+        return word | (num & 0x3ffffff);
+
+    }
+
+    //place the register values in order
+    for(int i = 0; i < instr.regCount; i++)
+    {
+        uint32_t reg = regs[i] & 0x1f;
+
+        Instruction::RegType t = instr.regOrder[i];
+        if(t == Instruction::rs)
+            word |= reg << 21;
+        else if(t == Instruction::rt)
+            word |= reg << 16;
+        else if(t == Instruction::rd)
+            word |= reg << 11;
+
+    }
+
+    if(instr.type == Instruction::R)
+    {
+        word |= (num & 0x1f) << 6; //shamt
+        word |= instr.funct & 0x3f;
+
+    }
+    else if(instr.type == Instruction::I)
+    {
+        word |= num & 0xffff;
+
+    }
+
+    return word;
+
+}
+
+int getRegNum(std::string_view reg)
+{
+    //$0 to $31 by number, without leading zeros
+    if(reg.size() >= 2 && reg[1] >= '0' && reg[1] <= '9')
+    {
+        int num = reg[1] - '0';
+        if(reg.size() == 3 && num != 0 && reg[2] >= '0' && reg[2] <= '9')
+        {
+            num = num * 10 + reg[2] - '0';
+
+        }
+        else if(reg.size() != 2)
+        {
+            return -1;
+
+        }
+
+        return num < 32 ? num : -1;
+
+    }
+
+    int slot = registerHash.slots[hashSlot(reg, registerHash.seed)];
+
+    if(slot < 0 || registerNames[slot] != reg)
+    {
+        return -1;
+
+    }
+
+    return slot < 32 ? slot : aliasNumbers[slot - 32];
+
+}
+
+std::string_view getRegName(int num)
+{
+    return registerNames[num];
+
+}
+
+std::string_view registerName(int num)
+{
+    return getRegName(num & 0x1f);
+
+}
+
+std::string_view instructionSyntax(size_t index)
+{
+    return index < (size_t)instructionCount ? instructions[index].syntax : std::string_view();
+
+}
+
+Label makeLabel(std::string_view name, uint32_t hash)
+{
+    Label label;
+    label.name = std::string(name);
+    label.address = -1;
+    label.last = false;
+    label.defined = false;
+    label.hash = hash;
+    return label;
+
+}
+
+uint32_t hashName(std::string_view name)
+{
+    //fnv-1a
+    uint32_t hash = 2166136261u;
+    for(unsigned int i = 0; i < name.size(); i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+
+    }
+
+    return hash;
+
+}
+
+Label* internLabel(Assembly& assembly, std::string_view name)
+{
+    if((assembly.labels.size() + 1) * 2 > assembly.labelSlots.size())
+    {
+        growLabelSlots(assembly);
+
+    }
+
+    uint32_t hash = hashName(name);
+    uint32_t mask = assembly.labelSlots.size() - 1;
+
+    assembly.labelLookups++;
+
+    //linear probe until an empty slot, stopping if the name is already there
+    uint32_t slot = hash & mask;
+    while(assembly.labelSlots[slot] >= 0)
+    {
+        Label& other = assembly.labels[assembly.labelSlots[slot]];
+        if(other.hash == hash && other.name == name)
+        {
+            return &other;
+
+        }
+
+        slot = (slot + 1) & mask;
+        assembly.labelProbes++;
+
+    }
+
+    assembly.labelSlots[slot] = assembly.labels.size();
+    assembly.labels.push_back(makeLabel(name, hash));
+    return &assembly.labels.back();
+
+}
+
+const Label* getLabel(const Assembly& assembly, std::string_view name, unsigned long& probes)
+{
+    if(assembly.labelSlots.size() == 0)
+    {
+        return NULL;
+
+    }
+
+    uint32_t hash = hashName(name);
+    uint32_t mask = assembly.labelSlots.size() - 1;
+
+    for(uint32_t slot = hash & mask; assembly.labelSlots[slot] >= 0; slot = (slot + 1) & mask)
+    {
+        const Label& label = assembly.labels[assembly.labelSlots[slot]];
+        if(label.hash == hash && label.name == name)
+        {
+            return &label;
+
+        }
+
+        probes++;
+
+    }
+
+    return NULL;
+
+}
+
+void growLabelSlots(Assembly& assembly)
+{
+    unsigned int capacity = assembly.labelSlots.size() < 16 ? 16 : assembly.labelSlots.size() * 2;
+    assembly.labelSlots.assign(capacity, -1);
+
+    //reinsert everything using the stored hashes
+    uint32_t mask = capacity - 1;
+    for(unsigned int i = 0; i < assembly.labels.size(); i++)
+    {
+        uint32_t slot = assembly.labels[i].hash & mask;
+        while(assembly.labelSlots[slot] >= 0)
+        {
+            slot = (slot + 1) & mask;
+
+        }
+
+        assembly.labelSlots[slot] = i;
+
+    }
+
+}
+
+int labelImmediate(const Instruction& instr, const Label& label, int pc)
+{
+    int imm = 0;
+
+    //calculate the jump offset
+    if(instr.type == Instruction::I)
+    {
+        int offset = label.address - pc;
+        imm = offset;
+
+        imm /= 4;
+        if(imm > 0 || imm < 0)
+        {
+            imm -= 1;
+
+        }
+
+        if(label.last)
+            imm++;
+
+    }
+    else if(instr.type == Instruction::J)
+    {
+        imm = label.address;
+        imm /= 4;
+        if(label.last)
+            imm++;
+
+    }
+
+    return imm;
+
+}
+
+uint32_t resolveLabel(uint32_t word, const Label& label, int pc)
+{
+    const Instruction& instr = getInstruction(word);
+    uint32_t mask = instr.type == Instruction::J ? 0x3ffffff : 0xffff;
+
+    //the operand bits are cleared first so a word can be filled in again
+    return (word & ~mask) | (labelImmediate(instr, label, pc) & mask);
+
+}
+
+bool splitLabel(std::string_view line, SourceLine& source, std::string& error)
+{
+    source.count = tokenize(line, source.tokens, maxTokens);
+    source.code = 0;
+    source.label = std::string_view();
+
+    //remove comment
+    if(source.count > 0 && source.tokens[source.count-1].kind == Token::Comment)
+    {
+        source.count--;
+
+    }
+
+    //parse for labels, everything before the first colon is the name
+    int colon = -1;
+    for(int i = 0; i < source.count && colon < 0; i++)
+    {
+        if(source.tokens[i].kind == Token::Colon)
+        {
+            colon = i;
+
+        }
+
+    }
+
+    if(colon < 0)
+    {
+        return true;
+
+    }
+
+    if(colon == 1 && source.tokens[0].kind == Token::Label)
+    {
+        source.label = source.tokens[0].text;
+        source.code = 2;
+        return true;
+
+    }
+
+    const char* begin = source.tokens[0].text.data();
+    std::string_view name(begin, source.tokens[colon].text.data() - begin);
+
+    bool alphanumeric = name.size() > 0;
+    for(unsigned int i = 0; i < name.size(); i++)
+    {
+        alphanumeric = alphanumeric && isWordChar(name[i]);
+
+    }
+
+    if(!alphanumeric)
+    {
+        error = std::string("label error: \"") + std::string(name) + "\"\nlabels may only contain alphanumeric characters\naborting\n";
+        return false;
+
+    }
+
+    error = std::string("label error: \"") + std::string(name) + "\"\nlabels may not start with a number\naborting\n";
+    return false;
+
+}
+
+bool encodeLine(const SourceLine& source, int lineNum, std::string_view fullLine, uint32_t& word, std::string_view& labelName, std::string& error, RunStats& stats, PhaseClock& clock)
+{
+    labelName = std::string_view();
+
+    const Token* tokens = source.tokens + source.code;
+    int count = source.count - source.code;
+
+    lap(clock, stats.encodeSeconds);
+    const Instruction& instr = tokens[0].kind == Token::Mnemonic ? getInstruction(tokens[0].text) : errorInstruction;
+    lap(clock, stats.lookupSeconds);
+
+    if(instr.type == Instruction::Error)
+    {
+        error = std::string(tokens[0].text) + " is not a valid operation\naborting\n";
+        return false;
+
+    }
+
+    int regs[3];
+    int regCount = 0;
+    int imm = 0;
+
+    //match the tokens up with the operands of the instruction one at a time
+    int next = 1;
+    for(int i = 0; i < instr.operandCount; i++, next++)
+    {
+        Instruction::Operand operand = instr.operands[i];
+        Token::Kind kind = next < count ? tokens[next].kind : Token::Comment;
+
+        if(kind == Token::Invalid)
+        {
+            error = syntaxError(lineNum, fullLine, std::string("unexpected \'") + std::string(tokens[next].text) + "\'");
+            return false;
+
+        }
+
+        if(operand == Instruction::Comma && kind != Token::Comma)
+        {
+            error = syntaxError(lineNum, fullLine, "missing \',\'");
+            return false;
+
+        }
+
+        if((operand == Instruction::LeftParen && kind != Token::LeftParen) ||
+           (operand == Instruction::RightParen && kind != Token::RightParen))
+        {
+            error = syntaxError(lineNum, fullLine, "missing \'(\' or \')\'");
+            return false;
+
+        }
+
+        if(operand == Instruction::Register)
+        {
+            if(kind != Token::Register)
+            {
+                error = std::string("not enough reg values. expected: ") + std::to_string(instr.regCount) + "\n";
+                return false;
+
+            }
+
+            lap(clock, stats.encodeSeconds);
+            int regNum = getRegNum(tokens[next].text);
+            lap(clock, stats.lookupSeconds);
+
+            if(regNum < 0)
+            {
+                error = std::string(tokens[next].text) + " is not a valid register name\naborting\n";
+                return false;
+
+            }
+
+            regs[regCount++] = regNum;
+
+        }
+        else if(operand == Instruction::Immediate)
+        {
+            if(kind == Token::Integer)
+            {
+                imm = tokens[next].value;
+
+                //numeric branch and jump targets are in bytes
+                if(instr.flag == Instruction::Jump)
+                {
+                    imm /= 4;
+
+                }
+
+            }
+            else if(kind == Token::Label && instr.flag == Instruction::Jump)
+            {
+                //label operands are left as 0 for the caller to resolve
+                labelName = tokens[next].text;
+
+            }
+            else
+            {
+                error = "immediate/offset/label expected none found\naborting\n";
+                return false;
+
+            }
+
+        }
+
+    }
+
+    if(next < count)
+    {
+        error = syntaxError(lineNum, fullLine, std::string("unexpected \'") + std::string(tokens[next].text) + "\'");
+        return false;
+
+    }
+
+    word = encodeInstruction(instr, regs, imm);
+
+    if(instr.type == Instruction::R)
+        stats.rTypes++;
+    else if(instr.type == Instruction::I)
+        stats.iTypes++;
+    else
+        stats.jTypes++;
+
+    lap(clock, stats.encodeSeconds);
+    return true;
+
+}
+
+std::string syntaxError(int lineNum, std::string_view fullLine, std::string_view reason)
+{
+    std::string error("syntax error on line ");
+    error += std::to_string(lineNum);
+    error += ": ";
+    error += fullLine;
+    error += "\n";
+    error += reason;
+    error += "\naborting\n";
+    return error;
+
+}
+
+Assembly makeAssembly(bool timing)
+{
+    Assembly assembly;
+    assembly.pc = 0x00400000;
+    assembly.lineNum = 0;
+    assembly.failed = false;
+    assembly.wordBase = 0;
+    assembly.labelLookups = 0;
+    assembly.labelProbes = 0;
+    assembly.timing = timing;
+    assembly.stats = makeRunStats();
+    return assembly;
+
+}
+
+RunStats makeRunStats()
+{
+    RunStats stats;
+    stats.readSeconds = 0.0;
+    stats.labelSeconds = 0.0;
+    stats.lexSeconds = 0.0;
+    stats.lookupSeconds = 0.0;
+    stats.encodeSeconds = 0.0;
+    stats.outputSeconds = 0.0;
+    stats.lines = 0;
+    stats.rTypes = 0;
+    stats.iTypes = 0;
+    stats.jTypes = 0;
+    stats.labels = 0;
+    stats.fixups = 0;
+    stats.regions = 0;
+    stats.reusedRegions = 0;
+    stats.bytesRead = 0;
+    stats.bytesWritten = 0;
+    stats.allocations = 0;
+    stats.allocatedBytes = 0;
+    stats.peakRssKb = 0;
+    return stats;
+
+}
+
+void addRunStats(RunStats& total, const RunStats& part)
+{
+    total.readSeconds += part.readSeconds;
+    total.labelSeconds += part.labelSeconds;
+    total.lexSeconds += part.lexSeconds;
+    total.lookupSeconds += part.lookupSeconds;
+    total.encodeSeconds += part.encodeSeconds;
+    total.outputSeconds += part.outputSeconds;
+    total.lines += part.lines;
+    total.rTypes += part.rTypes;
+    total.iTypes += part.iTypes;
+    total.jTypes += part.jTypes;
+    total.labels += part.labels;
+    total.fixups += part.fixups;
+    total.regions += part.regions;
+    total.reusedRegions += part.reusedRegions;
+    total.bytesRead += part.bytesRead;
+    total.bytesWritten += part.bytesWritten;
+    total.allocations += part.allocations;
+    total.allocatedBytes += part.allocatedBytes;
+    total.peakRssKb = std::max(total.peakRssKb, part.peakRssKb);
+
+}
+
+PhaseClock startClock(bool on)
+{
+    PhaseClock clock;
+    clock.on = on;
+    if(on)
+    {
+        clock.last = std::chrono::steady_clock::now();
+
+    }
+
+    return clock;
+
+}
+
+void lap(PhaseClock& clock, double& seconds)
+{
+    if(clock.on)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(now - clock.last).count();
+        clock.last = now;
+
+    }
+
+}
+
+bool assembleLine(Assembly& assembly, std::string_view source)
+{
+    if(assembly.failed)
+    {
+        return false;
+
+    }
+
+    assembly.lineNum++;
+    assembly.stats.lines++;
+
+    PhaseClock clock = startClock(assembly.timing);
+    SourceLine line;
+    std::string error;
+
+    if(!splitLabel(source, line, error))
+    {
+        assembly.diagnostics.push_back(error);
+        assembly.failed = true;
+        return false;
+
+    }
+
+    lap(clock, assembly.stats.lexSeconds);
+
+    if(line.label.size() > 0)
+    {
+        Label* label = internLabel(assembly, line.label);
+        if(label->defined)
+        {
+            assembly.diagnostics.push_back("label error: \"" + label->name + "\"\nlabel is already defined\naborting\n");
+            assembly.failed = true;
+            return false;
+
+        }
+
+        label->defined = true;
+        assembly.pendingLabels.push_back(label - &assembly.labels[0]);
+        assembly.stats.labels++;
+
+    }
+
+    //if there is nothing but a label and comment skip
+    if(line.code == line.count)
+    {
+        lap(clock, assembly.stats.labelSeconds);
+        return true;
+
+    }
+
+    //set the address of any labels waiting on the next line of actual code
+    for(unsigned int i = 0; i < assembly.pendingLabels.size(); i++)
+    {
+        assembly.labels[assembly.pendingLabels[i]].address = assembly.pc;
+
+    }
+    assembly.pendingLabels.clear();
+    lap(clock, assembly.stats.labelSeconds);
+
+    uint32_t word;
+    std::string_view name;
+    if(!encodeLine(line, assembly.lineNum, source, word, name, error, assembly.stats, clock))
+    {
+        assembly.diagnostics.push_back(error);
+        assembly.failed = true;
+        return false;
+
+    }
+
+    //labels that already have an address are resolved now, the rest get a fixup
+    if(name.size() > 0)
+    {
+        Label* label = internLabel(assembly, name);
+        if(label->address >= 0)
+        {
+            word = resolveLabel(word, *label, assembly.pc);
+
+        }
+        else
+        {
+            Fixup fixup;
+            fixup.word = assembly.wordBase + assembly.words.size();
+            fixup.pc = assembly.pc;
+            fixup.label = label - &assembly.labels[0];
+            assembly.fixups.push_back(fixup);
+            assembly.stats.fixups++;
+
+        }
+
+        lap(clock, assembly.stats.labelSeconds);
+
+    }
+
+    assembly.words.push_back(word);
+
+    assembly.pc += 0x000004;
+    return true;
+
+}
+
+AssembleResult finishAssembly(Assembly& assembly)
+{
+    AssembleResult result;
+    result.ok = false;
+
+    PhaseClock clock = startClock(assembly.timing);
+
+    if(!assembly.failed)
+    {
+        //check for putting a label at the end of code like an exit label
+        for(unsigned int i = 0; i < assembly.pendingLabels.size(); i++)
+        {
+            Label& label = assembly.labels[assembly.pendingLabels[i]];
+            label.address = assembly.pc - 0x000004;
+            label.last = true;
+
+        }
+        assembly.pendingLabels.clear();
+
+        //patch the forward references now that every label is placed
+        result.ok = true;
+        for(unsigned int i = 0; i < assembly.fixups.size(); i++)
+        {
+            const Fixup& fixup = assembly.fixups[i];
+            const Label& label = assembly.labels[fixup.label];
+            if(!label.defined)
+            {
+                assembly.diagnostics.push_back("label " + label.name + " does not exist\naborting\n");
+                result.ok = false;
+                break;
+
+            }
+
+            uint32_t& word = assembly.words[fixup.word - assembly.wordBase];
+            word = resolveLabel(word, label, fixup.pc);
+
+        }
+
+    }
+
+    if(result.ok)
+    {
+        result.words.swap(assembly.words);
+
+    }
+
+    lap(clock, assembly.stats.labelSeconds);
+
+    result.diagnostics.swap(assembly.diagnostics);
+    result.symbols = symbolStats(assembly);
+    result.labels.swap(assembly.labels);
+    result.stats = assembly.stats;
+    return result;
+
+}
+
+void takeWords(Assembly& assembly, std::vector<uint32_t>& out)
+{
+    if(assembly.failed)
+    {
+        return;
+
+    }
+
+    //patch from the front for as long as the labels are placed, a label only gets
+    //an address once the line after it is seen so these are final
+    size_t resolved = 0;
+    for(; resolved < assembly.fixups.size(); resolved++)
+    {
+        const Fixup& fixup = assembly.fixups[resolved];
+        const Label& label = assembly.labels[fixup.label];
+        if(label.address < 0)
+        {
+            break;
+
+        }
+
+        uint32_t& word = assembly.words[fixup.word - assembly.wordBase];
+        word = resolveLabel(word, label, fixup.pc);
+
+    }
+
+    assembly.fixups.erase(assembly.fixups.begin(), assembly.fixups.begin() + resolved);
+
+    size_t ready = assembly.fixups.empty() ? assembly.words.size() : assembly.fixups[0].word - assembly.wordBase;
+    if(ready == 0)
+    {
+        return;
+
+    }
+
+    out.insert(out.end(), assembly.words.begin(), assembly.words.begin() + ready);
+    assembly.words.erase(assembly.words.begin(), assembly.words.begin() + ready);
+    assembly.wordBase += ready;
+
+}
+
+AssembleResult assemble(std::string_view source, int threads, bool timing)
+{
+    if(threads > 1)
+    {
+        return parallelAssemble(source, threads, timing);
+
+    }
+
+    //split lines the same way getline does
+    Assembly assembly = makeAssembly(timing);
+    size_t start = 0;
+    while(start < source.size())
+    {
+        size_t stop = source.find('\n', start);
+        stop = stop == std::string_view::npos ? source.size() : stop;
+
+        if(!assembleLine(assembly, source.substr(start, stop - start)))
+        {
+            break;
+
+        }
+
+        start = stop + 1;
+
+    }
+
+    return finishAssembly(assembly);
+
+}
+
+//the same work as assemble split over threads:
+//each chunk counts its instructions and labels, a prefix sum gives every chunk
+//its base address, the labels are merged in source order, then the chunks are
+//encoded straight into their slots of the output
+AssembleResult parallelAssemble(std::string_view source, int threads, bool timing)
+{
+    Assembly assembly = makeAssembly(timing);
+
+    AssembleResult result;
+    result.ok = false;
+
+    //cut the source into line aligned chunks, a few per thread to even out the work
+    std::vector<SourceChunk> chunks;
+    size_t chunkSize = source.size() / (threads * 4) + 1;
+    size_t start = 0;
+    while(start < source.size())
+    {
+        size_t stop = source.find('\n', std::min(start + chunkSize, source.size() - 1));
+        stop = stop == std::string_view::npos ? source.size() : stop + 1;
+
+        SourceChunk chunk;
+        chunk.begin = source.data() + start;
+        chunk.end = source.data() + stop;
+        chunk.lines = 0;
+        chunk.words = 0;
+        chunk.lineBase = 0;
+        chunk.wordBase = 0;
+        chunk.errorLine = -1;
+        chunk.missingLine = -1;
+        chunk.lookups = 0;
+        chunk.probes = 0;
+        chunk.timing = timing;
+        chunk.stats = makeRunStats();
+        chunks.push_back(chunk);
+
+        start = stop;
+
+    }
+
+    //hand out chunks to the threads in order, each thread takes every nth one
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; t++)
+    {
+        pool.push_back(std::thread([&chunks, t, threads]()
+        {
+            for(unsigned int i = t; i < chunks.size(); i += threads)
+            {
+                scanChunk(chunks[i]);
+
+            }
+
+        }));
+
+    }
+
+    for(unsigned int t = 0; t < pool.size(); t++)
+    {
+        pool[t].join();
+
+    }
+
+    PhaseClock clock = startClock(timing);
+
+    //the first error by line number wins so they come out in source order
+    int errorLine = -1;
+    std::string error;
+
+    //prefix sum for the bases then merge the labels in source order
+    int lineBase = 0;
+    int wordBase = 0;
+    for(unsigned int i = 0; i < chunks.size(); i++)
+    {
+        SourceChunk& chunk = chunks[i];
+        chunk.lineBase = lineBase;
+        chunk.wordBase = wordBase;
+
+        if(chunk.errorLine >= 0 && errorLine < 0)
+        {
+            errorLine = lineBase + chunk.errorLine;
+            error = chunk.error;
+
+        }
+
+        for(unsigned int k = 0; k < chunk.labelNames.size() && errorLine < 0; k++)
+        {
+            Label* label = internLabel(assembly, chunk.labelNames[k]);
+            if(label->defined)
+            {
+                errorLine = lineBase + chunk.labelLines[k];
+                error = "label error: \"" + label->name + "\"\nlabel is already defined\naborting\n";
+                break;
+
+            }
+
+            label->defined = true;
+            label->address = 0x00400000 + (wordBase + chunk.labelWords[k]) * 4;
+            assembly.stats.labels++;
+
+        }
+
+        lineBase += chunk.lines;
+        wordBase += chunk.words;
+
+    }
+
+    //the scan stops a chunk at its first error, the encode pass can still find an earlier one
+    int endPc = 0x00400000 + wordBase * 4;
+    for(unsigned int i = 0; i < assembly.labels.size(); i++)
+    {
+        Label& label = assembly.labels[i];
+
+        //check for putting a label at the end of code like an exit label
+        if(label.address == endPc)
+        {
+            label.address = endPc - 0x000004;
+            label.last = true;
+
+        }
+
+    }
+
+    assembly.stats.lines = lineBase;
+    lap(clock, assembly.stats.labelSeconds);
+
+    std::vector<uint32_t> words(wordBase);
+
+    pool.clear();
+    for(int t = 0; t < threads; t++)
+    {
+        pool.push_back(std::thread([&assembly, &chunks, &words, t, threads]()
+        {
+            for(unsigned int i = t; i < chunks.size(); i += threads)
+            {
+                encodeChunk(assembly, chunks[i], words);
+
+            }
+
+        }));
+
+    }
+
+    for(unsigned int t = 0; t < pool.size(); t++)
+    {
+        pool[t].join();
+
+    }
+
+    int missingLine = -1;
+    std::string missing;
+    for(unsigned int i = 0; i < chunks.size(); i++)
+    {
+        SourceChunk& chunk = chunks[i];
+        assembly.labelLookups += chunk.lookups;
+        assembly.labelProbes += chunk.probes;
+        addRunStats(assembly.stats, chunk.stats);
+
+        if(chunk.errorLine >= 0 && (errorLine < 0 || chunk.lineBase + chunk.errorLine < errorLine))
+        {
+            errorLine = chunk.lineBase + chunk.errorLine;
+            error = chunk.error;
+
+        }
+
+        if(chunk.missingLine >= 0 && missingLine < 0)
+        {
+            missingLine = chunk.lineBase + chunk.missingLine;
+            missing = chunk.missing;
+
+        }
+
+    }
+
+    result.symbols = symbolStats(assembly);
+    result.labels.swap(assembly.labels);
+    result.stats = assembly.stats;
+
+    //missing labels only show up once everything else is fine, like in assemble
+    if(errorLine >= 0 || missingLine >= 0)
+    {
+        result.diagnostics.push_back(errorLine >= 0 ? error : missing);
+        return result;
+
+    }
+
+    result.ok = true;
+    result.words.swap(words);
+    return result;
+
+}
+
+SymbolStats symbolStats(const Assembly& assembly)
+{
+    SymbolStats stats;
+    stats.labels = assembly.labels.size();
+    stats.slots = assembly.labelSlots.size();
+    stats.lookups = assembly.labelLookups;
+    stats.probes = assembly.labelProbes;
+    return stats;
+
+}
+
+void scanChunk(SourceChunk& chunk)
+{
+    PhaseClock clock = startClock(chunk.timing);
+    SourceLine line;
+    std::string error;
+
+    const char* cursor = chunk.begin;
+    while(cursor < chunk.end)
+    {
+        const char* stop = std::find(cursor, chunk.end, '\n');
+        std::string_view source(cursor, stop - cursor);
+        cursor = stop < chunk.end ? stop + 1 : stop;
+        chunk.lines++;
+
+        if(!splitLabel(source, line, error))
+        {
+            chunk.errorLine = chunk.lines;
+            chunk.error = error;
+            lap(clock, chunk.stats.lexSeconds);
+            return;
+
+        }
+
+        if(line.label.size() > 0)
+        {
+            chunk.labelNames.push_back(line.label);
+            chunk.labelWords.push_back(chunk.words);
+            chunk.labelLines.push_back(chunk.lines);
+
+        }
+
+        if(line.code < line.count)
+        {
+            chunk.words++;
+
+        }
+
+    }
+
+    lap(clock, chunk.stats.lexSeconds);
+
+}
+
+void encodeChunk(const Assembly& assembly, SourceChunk& chunk, std::vector<uint32_t>& words)
+{
+    PhaseClock clock = startClock(chunk.timing);
+    SourceLine line;
+    std::string error;
+    std::string_view name;
+
+    int lineNum = 0;
+    int wordNum = chunk.wordBase;
+
+    const char* cursor = chunk.begin;
+    while(cursor < chunk.end)
+    {
+        const char* stop = std::find(cursor, chunk.end, '\n');
+        std::string_view source(cursor, stop - cursor);
+        cursor = stop < chunk.end ? stop + 1 : stop;
+        lineNum++;
+
+        //the scan already reported anything past here
+        if(chunk.errorLine >= 0 && lineNum >= chunk.errorLine)
+        {
+            return;
+
+        }
+
+        splitLabel(source, line, error);
+        lap(clock, chunk.stats.lexSeconds);
+        if(line.code == line.count)
+        {
+            continue;
+
+        }
+
+        uint32_t word;
+        if(!encodeLine(line, chunk.lineBase + lineNum, source, word, name, error, chunk.stats, clock))
+        {
+            chunk.errorLine = lineNum;
+            chunk.error = error;
+            return;
+
+        }
+
+        int wordPc = 0x00400000 + wordNum * 4;
+
+        if(name.size() > 0)
+        {
+            chunk.lookups++;
+            const Label* label = getLabel(assembly, name, chunk.probes);
+            if(label == NULL || !label->defined)
+            {
+                if(chunk.missingLine < 0)
+                {
+                    chunk.missingLine = lineNum;
+                    chunk.missing = "label " + std::string(name) + " does not exist\naborting\n";
+
+                }
+
+            }
+            else
+            {
+                word = resolveLabel(word, *label, wordPc);
+
+                //the ones the single threaded assembler would have had to patch later
+                if(label->address > wordPc || label->last)
+                {
+                    chunk.stats.fixups++;
+
+                }
+
+            }
+
+            lap(clock, chunk.stats.labelSeconds);
+
+        }
+
+        words[wordNum++] = word;
+
+    }
+
+}
+
+bool definesLabel(std::string_view line)
+{
+    //a colon before any comment, splitLabel does the real checking
+    for(size_t i = 0; i < line.size(); i++)
+    {
+        if(line[i] == ':')
+            return true;
+
+        if(line[i] == '#')
+            return false;
+
+    }
+
+    return false;
+
+}
+
+bool startsRegion(std::string_view line, uint64_t hash)
+{
+    //cuts mostly depend on the line itself so an edit does not move the cuts around it,
+    //about one label in 8 starts a region and one plain line in 1024 so files without labels still split
+    if(definesLabel(line))
+    {
+        return (hash & 7) == 0;
+
+    }
+
+    return (hash & 1023) == 0;
+
+}
+
+size_t nextRegion(std::string_view source, size_t start, uint64_t& hash)
+{
+    //the region hash is built from the line hashes so the text is only read once, the first
+    //line always belongs to the region and repetitive source that never hits a cut gets one
+    //every regionMaxLines instead
+    hash = 14695981039346656037ull;
+    int lines = 0;
+    size_t line = start;
+    while(line < source.size())
+    {
+        size_t stop = source.find('\n', line);
+        stop = stop == std::string_view::npos ? source.size() : stop;
+
+        std::string_view text = source.substr(line, stop - line);
+        uint64_t lineHash = hashLine(text);
+        if(lines > 0 && (lines == regionMaxLines || startsRegion(text, lineHash)))
+        {
+            return line;
+
+        }
+
+        hash = (hash ^ lineHash) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+        lines++;
+        line = stop + 1;
+
+    }
+
+    return source.size();
+
+}
+
+uint64_t hashLine(std::string_view line)
+{
+    //fnv-1a 64
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < line.size(); i++)
+    {
+        hash ^= (unsigned char)line[i];
+        hash *= 1099511628211ull;
+
+    }
+
+    return hash;
+
+}
+
+bool encodeRegion(std::string_view text, Region& region, std::string& error, RunStats& stats, PhaseClock& clock)
+{
+    SourceLine line;
+    std::string_view name;
+
+    region.lines = 0;
+    region.base = -1;
+    region.fixups = 0;
+    region.rTypes = 0;
+    region.iTypes = 0;
+    region.jTypes = 0;
+
+    size_t start = 0;
+    while(start < text.size())
+    {
+        size_t stop = text.find('\n', start);
+        stop = stop == std::string_view::npos ? text.size() : stop;
+        std::string_view source = text.substr(start, stop - start);
+        start = stop + 1;
+
+        region.lines++;
+        stats.lines++;
+
+        if(!splitLabel(source, line, error))
+        {
+            return false;
+
+        }
+
+        lap(clock, stats.lexSeconds);
+
+        if(line.label.size() > 0)
+        {
+            region.labelNames.push_back(std::string(line.label));
+            region.labelWords.push_back(region.words.size());
+
+        }
+
+        if(line.code == line.count)
+        {
+            continue;
+
+        }
+
+        uint32_t word;
+        RunStats before = stats;
+        if(!encodeLine(line, region.lines, source, word, name, error, stats, clock))
+        {
+            return false;
+
+        }
+
+        region.rTypes += stats.rTypes - before.rTypes;
+        region.iTypes += stats.iTypes - before.iTypes;
+        region.jTypes += stats.jTypes - before.jTypes;
+
+        if(name.size() > 0)
+        {
+            region.relocWords.push_back(region.words.size());
+            region.relocLabels.push_back(std::string(name));
+            region.relocTargets.push_back(-1);
+
+        }
+
+        region.words.push_back(word);
+
+    }
+
+    return true;
+
+}
+
+int findRegion(const RegionCache& cache, uint64_t hash, std::string_view text, const std::vector<bool>& taken)
+{
+    if(cache.slots.size() == 0)
+    {
+        return -1;
+
+    }
+
+    uint32_t mask = cache.slots.size() - 1;
+    for(uint32_t slot = hash & mask; cache.slots[slot] >= 0; slot = (slot + 1) & mask)
+    {
+        const Region& region = cache.regions[cache.slots[slot]];
+        if(region.hash == hash && !taken[cache.slots[slot]] && region.text == text)
+        {
+            return cache.slots[slot];
+
+        }
+
+    }
+
+    return -1;
+
+}
+
+void indexRegions(RegionCache& cache)
+{
+    //a power of two at least twice the number of regions
+    size_t capacity = 16;
+    while(capacity < cache.regions.size() * 2)
+    {
+        capacity *= 2;
+
+    }
+
+    cache.slots.assign(capacity, -1);
+
+    uint32_t mask = capacity - 1;
+    for(unsigned int i = 0; i < cache.regions.size(); i++)
+    {
+        uint32_t slot = cache.regions[i].hash & mask;
+        while(cache.slots[slot] >= 0)
+        {
+            slot = (slot + 1) & mask;
+
+        }
+
+        cache.slots[slot] = i;
+
+    }
+
+}
+
+AssembleResult assembleIncremental(std::string_view source, RegionCache& cache, bool timing)
+{
+    Assembly assembly = makeAssembly(timing);
+    PhaseClock clock = startClock(timing);
+
+    std::string error;
+    bool failed = false;
+
+    //split into regions, look each one up and encode what the cache doesn't have
+    //sources has the cache index of every region, or -1 for the next one in encoded
+    std::vector<int> sources;
+    std::vector<Region> encoded;
+    std::vector<bool> taken(cache.regions.size(), false);
+    size_t start = 0;
+    while(start < source.size())
+    {
+        uint64_t hash;
+        size_t stop = nextRegion(source, start, hash);
+        std::string_view text = source.substr(start, stop - start);
+        start = stop;
+
+        int found = findRegion(cache, hash, text, taken);
+        lap(clock, assembly.stats.lexSeconds);
+
+        if(found >= 0)
+        {
+            //taken so a second copy of the same text gets encoded on its own
+            const Region& region = cache.regions[found];
+            taken[found] = true;
+            sources.push_back(found);
+            assembly.stats.lines += region.lines;
+            assembly.stats.rTypes += region.rTypes;
+            assembly.stats.iTypes += region.iTypes;
+            assembly.stats.jTypes += region.jTypes;
+            assembly.stats.reusedRegions++;
+            continue;
+
+        }
+
+        Region region;
+        region.hash = hash;
+        region.text = std::string(text);
+        if(!encodeRegion(text, region, error, assembly.stats, clock))
+        {
+            failed = true;
+            break;
+
+        }
+
+        sources.push_back(-1);
+        encoded.push_back(std::move(region));
+
+    }
+
+    //lay the regions out again, a cached region stays when it is back at the same index and word
+    //so its labels keep their addresses. the symbol table starts over if the cache had no layout
+    //or it is mostly stale names
+    std::vector<int> bases(sources.size());
+    int wordBase = 0;
+    size_t live = 0;
+    for(unsigned int i = 0, k = 0; i < sources.size(); i++)
+    {
+        bases[i] = wordBase;
+        wordBase += sources[i] >= 0 ? cache.regions[sources[i]].words.size() : encoded[k++].words.size();
+
+    }
+
+    for(unsigned int i = 0; i < cache.regions.size(); i++)
+    {
+        live += cache.regions[i].labelNames.size();
+
+    }
+
+    bool laidOut = cache.regions.size() > 0 && cache.regions[0].base >= 0;
+    if(!laidOut || cache.symbols.labels.size() > live * 2 + 64)
+    {
+        cache.symbols = makeAssembly();
+        laidOut = false;
+
+    }
+
+    std::vector<bool> stays(cache.regions.size(), false);
+    for(unsigned int i = 0; i < sources.size() && i < cache.regions.size() && laidOut; i++)
+    {
+        stays[i] = sources[i] == (int)i && cache.regions[i].base == bases[i];
+
+    }
+
+    //the labels of the regions that don't stay come out of the table, the addresses they had
+    //(and the end of code if it moved) are the only ones a label can have moved from. each range
+    //starts a word early for a label at the end of code, which was filled in as the word before
+    std::vector<int> movedFrom;
+    std::vector<int> movedTo;
+    int oldEnd = 0x00400000;
+    for(unsigned int i = 0; i < cache.regions.size(); i++)
+    {
+        const Region& region = cache.regions[i];
+        int begin = 0x00400000 + region.base * 4;
+        oldEnd = begin + region.words.size() * 4;
+        if(stays[i])
+        {
+            continue;
+
+        }
+
+        if(movedTo.size() > 0 && movedTo.back() >= begin - 0x000004)
+            movedTo.back() = oldEnd + 1;
+        else
+        {
+            movedFrom.push_back(begin - 0x000004);
+            movedTo.push_back(oldEnd + 1);
+
+        }
+
+        for(unsigned int k = 0; k < region.labelNames.size() && laidOut; k++)
+        {
+            internLabel(cache.symbols, region.labelNames[k])->defined = false;
+
+        }
+
+    }
+
+    int endPc = 0x00400000 + wordBase * 4;
+    if(laidOut && oldEnd != endPc && movedTo.size() > 0 && movedTo.back() >= oldEnd - 0x000004)
+        movedTo.back() = oldEnd + 1;
+    else if(laidOut && oldEnd != endPc)
+    {
+        movedFrom.push_back(oldEnd - 0x000004);
+        movedTo.push_back(oldEnd + 1);
+
+    }
+
+    std::vector<Region> regions;
+    regions.reserve(sources.size());
+    for(unsigned int i = 0, k = 0; i < sources.size(); i++)
+    {
+        regions.push_back(std::move(sources[i] >= 0 ? cache.regions[sources[i]] : encoded[k++]));
+
+    }
+
+    //place the labels of the regions that don't stay
+    unsigned long lookups = cache.symbols.labelLookups;
+    unsigned long probes = cache.symbols.labelProbes;
+
+    for(unsigned int i = 0; i < regions.size() && !failed; i++)
+    {
+        const Region& region = regions[i];
+        for(unsigned int k = 0; k < region.labelNames.size() && !(i < stays.size() && stays[i]); k++)
+        {
+            Label* label = internLabel(cache.symbols, region.labelNames[k]);
+            if(label->defined)
+            {
+                failed = true;
+                break;
+
+            }
+
+            label->defined = true;
+            label->address = 0x00400000 + (bases[i] + region.labelWords[k]) * 4;
+
+        }
+
+        assembly.stats.labels += region.labelNames.size();
+
+    }
+
+    //fill in every label operand of a region at a new word, and in the others the operands that
+    //were filled in with an address a label moved from. a label at the end of code like an exit
+    //label is resolved as the last word
+    Label placed = makeLabel("", 0);
+    for(unsigned int i = 0; i < regions.size() && !failed; i++)
+    {
+        Region& region = regions[i];
+        bool moved = region.base != bases[i];
+        if(moved)
+        {
+            region.fixups = 0;
+
+        }
+
+        bool patched = false;
+        for(unsigned int range = 0; range < movedFrom.size() || (moved && range == 0); range++)
+        {
+            std::vector<int>::iterator targets = region.relocTargets.begin();
+            size_t k = moved ? 0 : std::lower_bound(targets, region.relocTargets.end(), movedFrom[range]) - targets;
+            size_t stop = moved ? region.relocWords.size() : std::lower_bound(targets, region.relocTargets.end(), movedTo[range]) - targets;
+            for(; k < stop; k++)
+            {
+                unsigned long extra = 0;
+                const Label* label = getLabel(cache.symbols, region.relocLabels[k], extra);
+                cache.symbols.labelLookups++;
+                cache.symbols.labelProbes += extra;
+
+                if(label == NULL || !label->defined)
+                {
+                    failed = true;
+                    break;
+
+                }
+
+                int target = labelTarget(*label, endPc);
+                if(!moved && target == region.relocTargets[k])
+                {
+                    continue;
+
+                }
+
+                int pc = 0x00400000 + (bases[i] + region.relocWords[k]) * 4;
+                if(!moved && pointsForward(region.relocTargets[k], pc))
+                {
+                    region.fixups--;
+
+                }
+
+                placed.address = target & ~3;
+                placed.last = (target & 1) != 0;
+
+                uint32_t& word = region.words[region.relocWords[k]];
+                word = resolveLabel(word, placed, pc);
+                region.relocTargets[k] = target;
+                region.fixups += pointsForward(target, pc);
+                patched = true;
+
+            }
+
+            if(moved || failed)
+            {
+                break;
+
+            }
+
+        }
+
+        region.base = bases[i];
+        if(patched)
+        {
+            sortRelocations(region);
+
+        }
+
+        assembly.stats.fixups += region.fixups;
+
+    }
+
+    lap(clock, assembly.stats.labelSeconds);
+
+    assembly.stats.regions = regions.size();
+
+    //keep whatever encoded cleanly for next time, after a failure without any layout
+    cache.regions.swap(regions);
+    indexRegions(cache);
+
+    //errors come from a clean run so they read exactly the same
+    if(failed)
+    {
+        for(unsigned int i = 0; i < cache.regions.size(); i++)
+        {
+            cache.regions[i].base = -1;
+
+        }
+
+        cache.symbols = makeAssembly();
+
+        RunStats stats = assembly.stats;
+        AssembleResult result = assemble(source, 1, timing);
+        result.stats.regions = stats.regions;
+        result.stats.reusedRegions = stats.reusedRegions;
+        return result;
+
+    }
+
+    AssembleResult result;
+    result.ok = true;
+    result.words.reserve(wordBase);
+    for(unsigned int i = 0; i < cache.regions.size(); i++)
+    {
+        const Region& region = cache.regions[i];
+        result.words.insert(result.words.end(), region.words.begin(), region.words.end());
+
+        for(unsigned int k = 0; k < region.labelNames.size(); k++)
+        {
+            Label label = makeLabel(region.labelNames[k], hashName(region.labelNames[k]));
+            label.defined = true;
+            label.address = 0x00400000 + (region.base + region.labelWords[k]) * 4;
+            if(label.address == endPc)
+            {
+                label.address = endPc - 0x000004;
+                label.last = true;
+
+            }
+
+            result.labels.push_back(std::move(label));
+
+        }
+
+    }
+
+    result.symbols = symbolStats(cache.symbols);
+    result.symbols.lookups = cache.symbols.labelLookups - lookups;
+    result.symbols.probes = cache.symbols.labelProbes - probes;
+    result.stats = assembly.stats;
+    return result;
+
+}
+
+int labelTarget(const Label& label, int endPc)
+{
+    //the address is a multiple of 4 so the low bit is free to mark the end of code
+    return label.address == endPc ? endPc - 0x000004 + 1 : label.address;
+
+}
+
+bool pointsForward(int target, int pc)
+{
+    return target >= 0 && ((target & ~3) > pc || (target & 1) != 0);
+
+}
+
+void sortRelocations(Region& region)
+{
+    if(std::is_sorted(region.relocTargets.begin(), region.relocTargets.end()))
+    {
+        return;
+
+    }
+
+    std::vector<int> order(region.relocWords.size());
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+
+    }
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return region.relocTargets[a] < region.relocTargets[b]; });
+
+    std::vector<int> words(order.size());
+    std::vector<std::string> labels(order.size());
+    std::vector<int> targets(order.size());
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        words[i] = region.relocWords[order[i]];
+        labels[i].swap(region.relocLabels[order[i]]);
+        targets[i] = region.relocTargets[order[i]];
+
+    }
+
+    region.relocWords.swap(words);
+    region.relocLabels.swap(labels);
+    region.relocTargets.swap(targets);
+
+}
+
+void appendU32(std::string& out, uint32_t value)
+{
+    //little-endian no matter the host
+    char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+    out.append(bytes, 4);
+
+}
+
+void appendText(std::string& out, const std::string& text)
+{
+    appendU32(out, text.size());
+    out += text;
+
+}
+
+bool readU32(const char*& cursor, const char* end, uint32_t& value)
+{
+    if(end - cursor < 4)
+    {
+        return false;
+
+    }
+
+    const unsigned char* bytes = (const unsigned char*)cursor;
+    value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    cursor += 4;
+    return true;
+
+}
+
+bool readText(const char*& cursor, const char* end, std::string& text)
+{
+    uint32_t size;
+    if(!readU32(cursor, end, size) || (size_t)(end - cursor) < size)
+    {
+        return false;
+
+    }
+
+    text.assign(cursor, size);
+    cursor += size;
+    return true;
+
+}
+
+void saveRegionCache(const RegionCache& cache, std::string& out)
+{
+    //"DVR" and a format version, then the regions one after another
+    out.append("DVR\x04", 4);
+    appendU32(out, cache.regions.size());
+
+    for(unsigned int i = 0; i < cache.regions.size(); i++)
+    {
+        const Region& region = cache.regions[i];
+        appendU32(out, region.hash & 0xffffffff);
+        appendU32(out, region.hash >> 32);
+        appendText(out, region.text);
+        appendU32(out, region.lines);
+        appendU32(out, region.rTypes);
+        appendU32(out, region.iTypes);
+        appendU32(out, region.jTypes);
+        appendU32(out, region.base);
+        appendU32(out, region.fixups);
+
+        appendU32(out, region.words.size());
+        for(unsigned int k = 0; k < region.words.size(); k++)
+        {
+            appendU32(out, region.words[k]);
+
+        }
+
+        appendU32(out, region.labelNames.size());
+        for(unsigned int k = 0; k < region.labelNames.size(); k++)
+        {
+            appendU32(out, region.labelWords[k]);
+            appendText(out, region.labelNames[k]);
+
+        }
+
+        appendU32(out, region.relocWords.size());
+        for(unsigned int k = 0; k < region.relocWords.size(); k++)
+        {
+            appendU32(out, region.relocWords[k]);
+            appendU32(out, region.relocTargets[k]);
+            appendText(out, region.relocLabels[k]);
+
+        }
+
+    }
+
+}
+
+bool loadRegionCache(RegionCache& cache, const char* data, size_t size)
+{
+    cache.regions.clear();
+    cache.slots.clear();
+
+    const char* cursor = data;
+    const char* end = data + size;
+
+    uint32_t count;
+    if(size < 4 || memcmp(data, "DVR\x04", 4) != 0)
+    {
+        return false;
+
+    }
+
+    cursor += 4;
+    bool ok = readU32(cursor, end, count);
+
+    for(uint32_t i = 0; i < count && ok; i++)
+    {
+        Region region;
+        uint32_t low = 0, high = 0, lines = 0, rTypes = 0, iTypes = 0, jTypes = 0, base = 0, fixups = 0, words = 0, labels = 0, relocs = 0;
+        ok = readU32(cursor, end, low) && readU32(cursor, end, high) && readText(cursor, end, region.text) &&
+             readU32(cursor, end, lines) && readU32(cursor, end, rTypes) && readU32(cursor, end, iTypes) &&
+             readU32(cursor, end, jTypes) && readU32(cursor, end, base) && readU32(cursor, end, fixups) &&
+             readU32(cursor, end, words) && (size_t)(end - cursor) / 4 >= words;
+
+        region.hash = ((uint64_t)high << 32) | low;
+        region.lines = lines;
+        region.rTypes = rTypes;
+        region.iTypes = iTypes;
+        region.jTypes = jTypes;
+        region.base = base;
+        region.fixups = fixups;
+
+        for(uint32_t k = 0; k < words && ok; k++)
+        {
+            uint32_t word;
+            ok = readU32(cursor, end, word);
+            region.words.push_back(word);
+
+        }
+
+        ok = ok && readU32(cursor, end, labels);
+        for(uint32_t k = 0; k < labels && ok; k++)
+        {
+            uint32_t word = 0;
+            std::string name;
+            ok = readU32(cursor, end, word) && readText(cursor, end, name) && word <= region.words.size();
+            region.labelWords.push_back(word);
+            region.labelNames.push_back(name);
+
+        }
+
+        ok = ok && readU32(cursor, end, relocs);
+        for(uint32_t k = 0; k < relocs && ok; k++)
+        {
+            uint32_t word = 0, target = 0;
+            std::string name;
+            ok = readU32(cursor, end, word) && readU32(cursor, end, target) && readText(cursor, end, name) && word < region.words.size();
+            region.relocWords.push_back(word);
+            region.relocTargets.push_back(target);
+            region.relocLabels.push_back(name);
+
+        }
+
+        cache.regions.push_back(std::move(region));
+
+    }
+
+    if(!ok || cursor != end)
+    {
+        cache.regions.clear();
+        return false;
+
+    }
+
+    //the labels go back where the regions put them, unless the regions weren't laid out
+    //one after another in which case everything is filled in again on the next assembly
+    cache.symbols = makeAssembly();
+    int wordBase = 0;
+    for(unsigned int i = 0; i < cache.regions.size() && ok; i++)
+    {
+        const Region& region = cache.regions[i];
+        ok = region.base == wordBase;
+        for(unsigned int k = 0; k < region.labelNames.size() && ok; k++)
+        {
+            Label* label = internLabel(cache.symbols, region.labelNames[k]);
+            ok = !label->defined;
+            label->defined = true;
+            label->address = 0x00400000 + (wordBase + region.labelWords[k]) * 4;
+
+        }
+
+        wordBase += region.words.size();
+
+    }
+
+    for(unsigned int i = 0; i < cache.regions.size() && !ok; i++)
+    {
+        cache.regions[i].base = -1;
+
+    }
+
+    indexRegions(cache);
+    return true;
+
+}
+
+ObjectResult assembleObject(std::string_view source, bool timing)
+{
+    ObjectResult result;
+    result.ok = false;
+    result.stats = makeRunStats();
+
+    PhaseClock clock = startClock(timing);
+
+    //the whole module is one region, which already leaves the label operands out
+    Region region;
+    std::string error;
+    bool ok = encodeRegion(source, region, error, result.stats, clock);
+
+    //defined labels are interned first so a symbol's index is its label index
+    Assembly symbols = makeAssembly();
+    ObjectModule& module = result.module;
+    for(unsigned int i = 0; i < region.labelNames.size() && ok; i++)
+    {
+        Label* label = internLabel(symbols, region.labelNames[i]);
+        if(label->defined)
+        {
+            ok = false;
+            break;
+
+        }
+
+        label->defined = true;
+        module.symbols.push_back(region.labelNames[i]);
+        module.symbolWords.push_back(region.labelWords[i]);
+        result.stats.labels++;
+
+    }
+
+    //anything referred to but not defined here is imported
+    for(unsigned int i = 0; i < region.relocWords.size() && ok; i++)
+    {
+        Label* label = internLabel(symbols, region.relocLabels[i]);
+        unsigned int symbol = label - &symbols.labels[0];
+        if(symbol == module.symbols.size())
+        {
+            module.symbols.push_back(region.relocLabels[i]);
+            module.symbolWords.push_back(-1);
+
+        }
+
+        uint32_t word = region.words[region.relocWords[i]];
+        bool jump = getInstruction(word).type == Instruction::J;
+
+        module.relocWords.push_back(region.relocWords[i]);
+        module.relocSymbols.push_back(symbol);
+        module.relocKinds.push_back(jump ? ObjectModule::Jump : ObjectModule::Branch);
+        result.stats.fixups++;
+
+    }
+
+    lap(clock, result.stats.labelSeconds);
+
+    //errors come from a clean run so they read exactly the same
+    if(!ok)
+    {
+        AssembleResult clean = assemble(source);
+        result.diagnostics.swap(clean.diagnostics);
+        result.module = ObjectModule();
+        return result;
+
+    }
+
+    module.words.swap(region.words);
+    result.ok = true;
+    return result;
+
+}
+
+void saveObject(const ObjectModule& module, std::string& out)
+{
+    //"DVO" and a format version, then the words, the symbols and the relocations
+    out.append("DVO\x01", 4);
+
+    appendU32(out, module.words.size());
+    for(unsigned int i = 0; i < module.words.size(); i++)
+    {
+        appendU32(out, module.words[i]);
+
+    }
+
+    appendU32(out, module.symbols.size());
+    for(unsigned int i = 0; i < module.symbols.size(); i++)
+    {
+        appendU32(out, module.symbolWords[i]);
+        appendText(out, module.symbols[i]);
+
+    }
+
+    appendU32(out, module.relocWords.size());
+    for(unsigned int i = 0; i < module.relocWords.size(); i++)
+    {
+        appendU32(out, module.relocWords[i]);
+        appendU32(out, module.relocSymbols[i]);
+        appendU32(out, module.relocKinds[i]);
+
+    }
+
+}
+
+bool loadObject(ObjectModule& module, const char* data, size_t size)
+{
+    module = ObjectModule();
+
+    const char* cursor = data;
+    const char* end = data + size;
+
+    if(size < 4 || memcmp(data, "DVO\x01", 4) != 0)
+    {
+        return false;
+
+    }
+
+    cursor += 4;
+
+    uint32_t count = 0;
+    bool ok = readU32(cursor, end, count) && (size_t)(end - cursor) / 4 >= count;
+    for(uint32_t i = 0; i < count && ok; i++)
+    {
+        uint32_t word = 0;
+        ok = readU32(cursor, end, word);
+        module.words.push_back(word);
+
+    }
+
+    //imported symbols are stored with a word of -1
+    ok = ok && readU32(cursor, end, count);
+    for(uint32_t i = 0; i < count && ok; i++)
+    {
+        uint32_t word = 0;
+        std::string name;
+        ok = readU32(cursor, end, word) && readText(cursor, end, name) && name.size() > 0;
+        ok = ok && ((int)word == -1 || word <= module.words.size());
+        module.symbolWords.push_back(word);
+        module.symbols.push_back(name);
+
+    }
+
+    //a relocation has to land on a word of the kind it says
+    ok = ok && readU32(cursor, end, count);
+    for(uint32_t i = 0; i < count && ok; i++)
+    {
+        uint32_t word = 0, symbol = 0, kind = 0;
+        ok = readU32(cursor, end, word) && readU32(cursor, end, symbol) && readU32(cursor, end, kind);
+        ok = ok && word < module.words.size() && symbol < module.symbols.size() && kind <= ObjectModule::Jump;
+        if(ok)
+        {
+            Instruction::Type type = getInstruction(module.words[word]).type;
+            ok = type == (kind == ObjectModule::Jump ? Instruction::J : Instruction::I);
+
+        }
+
+        module.relocWords.push_back(word);
+        module.relocSymbols.push_back(symbol);
+        module.relocKinds.push_back((ObjectModule::Reloc)kind);
+
+    }
+
+    if(!ok || cursor != end)
+    {
+        module = ObjectModule();
+        return false;
+
+    }
+
+    return true;
+
+}
+
+AssembleResult link(const std::vector<ObjectModule>& modules, bool timing)
+{
+    AssembleResult result;
+    result.ok = false;
+
+    Assembly assembly = makeAssembly(timing);
+    PhaseClock clock = startClock(timing);
+
+    //lay the modules out one after another and place every exported symbol,
+    //remembering the global label of each module symbol so relocations need no lookups
+    std::vector<std::vector<int>> globals(modules.size());
+    int wordBase = 0;
+    for(unsigned int i = 0; i < modules.size(); i++)
+    {
+        const ObjectModule& module = modules[i];
+        globals[i].resize(module.symbols.size());
+
+        for(unsigned int k = 0; k < module.symbols.size(); k++)
+        {
+            Label* label = internLabel(assembly, module.symbols[k]);
+            globals[i][k] = label - &assembly.labels[0];
+
+            if(module.symbolWords[k] < 0)
+            {
+                continue;
+
+            }
+
+            if(label->defined)
+            {
+                assembly.diagnostics.push_back("label error: \"" + label->name + "\"\nlabel is already defined\naborting\n");
+                result.diagnostics.swap(assembly.diagnostics);
+                return result;
+
+            }
+
+            label->defined = true;
+            label->address = 0x00400000 + (wordBase + module.symbolWords[k]) * 4;
+            assembly.stats.labels++;
+
+        }
+
+        wordBase += module.words.size();
+
+    }
+
+    //check for putting a label at the end of code like an exit label
+    int endPc = 0x00400000 + wordBase * 4;
+    for(unsigned int i = 0; i < assembly.labels.size(); i++)
+    {
+        Label& label = assembly.labels[i];
+        if(label.address == endPc)
+        {
+            label.address = endPc - 0x000004;
+            label.last = true;
+
+        }
+
+    }
+
+    //one pass over the relocations in address order
+    std::vector<uint32_t> words;
+    words.reserve(wordBase);
+    result.ok = true;
+    for(unsigned int i = 0; i < modules.size() && result.ok; i++)
+    {
+        const ObjectModule& module = modules[i];
+        int base = words.size();
+        words.insert(words.end(), module.words.begin(), module.words.end());
+
+        for(unsigned int k = 0; k < module.relocWords.size(); k++)
+        {
+            const Label& label = assembly.labels[globals[i][module.relocSymbols[k]]];
+            if(!label.defined)
+            {
+                assembly.diagnostics.push_back("label " + label.name + " does not exist\naborting\n");
+                result.ok = false;
+                break;
+
+            }
+
+            int word = base + module.relocWords[k];
+            words[word] = resolveLabel(words[word], label, 0x00400000 + word * 4);
+            assembly.stats.fixups++;
+
+        }
+
+    }
+
+    lap(clock, assembly.stats.labelSeconds);
+
+    if(result.ok)
+    {
+        result.words.swap(words);
+
+    }
+
+    result.diagnostics.swap(assembly.diagnostics);
+    result.symbols = symbolStats(assembly);
+    result.labels.swap(assembly.labels);
+    result.stats = assembly.stats;
+    return result;
+
+}
+
+void writeInstruction(const Instruction& instr, uint32_t word, std::string& out)
+{
+    //read all the register values
+    int rs = (word >> 21) & 0x1f;
+    int rt = (word >> 16) & 0x1f;
+    int rd = (word >> 11) & 0x1f;
+    int shamt = (word >> 6) & 0x1f;
+
+    out += instr.opname;
+    out += " ";
+
+    if(instr.type == Instruction::R)
+    {
+        for(int i = 0; i < instr.regCount; i++)
+        {
+            Instruction::RegType t = instr.regOrder[i];
+            if(t == Instruction::rs)
+                out += getRegName(rs);
+            else if(t == Instruction::rt)
+                out += getRegName(rt);
+            else if(t == Instruction::rd)
+                out += getRegName(rd);
+
+            if(i != instr.regCount-1)
+            {
+                out += ", ";
+
+            }
+
+        }
+
+        //only sll and srl have a shift amount, everything else leaves the field alone
+        if(instr.operands[instr.operandCount-1] == Instruction::Immediate)
+        {
+            out += ", " + std::to_string(shamt);
+
+        }
+
+    }
+    else if(instr.type == Instruction::I)
+    {
+        //16 bit immediate value, offsets and branches are signed
+        int imm = word & 0xffff;
+        int signedImm = (int16_t)imm;
+
+        for(int i = 0; i < instr.regCount; i++)
+        {
+            Instruction::RegType t = instr.regOrder[i];
+            if(t == Instruction::rs)
+            {
+                //handle things like 8($s0)
+                if(instr.flag == Instruction::Offset)
+                {
+                    out += std::to_string(signedImm);
+                    out += '(';
+                    out += getRegName(rs);
+                    out += ')';
+
+                }
+                else
+                {
+                    out += getRegName(rs);
+
+                }
+
+            }
+            else if(t == Instruction::rt)
+            {
+                out += getRegName(rt);
+
+            }
+
+            if(i != instr.regCount-1)
+            {
+                out += ", ";
+
+            }
+
+        }
+
+        if(instr.flag == Instruction::Jump)
+        {
+            out += ", " + std::to_string(signedImm * 4);
+
+        }
+        else if(instr.flag != Instruction::Offset)
+        {
+            out += ", " + std::to_string(imm);
+
+        }
+
+    }
+    else if(instr.type == Instruction::J)
+    {
+        //26 bit target address
+        int value = word & 0x3ffffff;
+        value *= 4;
+
+        out += std::to_string(value);
+
+    }
+
+    out += "\n";
+
+}
+
+bool disassembleWord(uint32_t word, std::string& text)
+{
+    const Instruction& instr = getInstruction(word);
+
+    if(instr.type == Instruction::Error)
+    {
+        return false;
+
+    }
+
+    writeInstruction(instr, word, text);
+    return true;
+
+}
+
+bool disassembleWord(uint32_t word, std::string& text, RunStats& stats, bool timing)
+{
+    PhaseClock clock = startClock(timing);
+    const Instruction& instr = getInstruction(word);
+    lap(clock, stats.lookupSeconds);
+
+    if(instr.type == Instruction::Error)
+    {
+        return false;
+
+    }
+
+    writeInstruction(instr, word, text);
+    lap(clock, stats.encodeSeconds);
+
+    stats.lines++;
+    if(instr.type == Instruction::R)
+        stats.rTypes++;
+    else if(instr.type == Instruction::I)
+        stats.iTypes++;
+    else
+        stats.jTypes++;
+
+    return true;
+
+}
+
+DisassembleResult disassemble(const uint32_t* words, size_t count, int threads, bool timing)
+{
+    return disassembleWords(words, count, threads, NULL, timing);
+
+}
+
+DisassembleResult disassemble(const std::vector<uint32_t>& words, int threads, bool timing)
+{
+    return disassemble(words.data(), words.size(), threads, timing);
+
+}
+
+DisassembleResult disassembleLabeled(const uint32_t* words, size_t count, int threads, bool timing)
+{
+    //first pass: a bit for every word a branch or jump lands on, one past the last word included
+    std::vector<uint64_t> targets(count / 64 + 1, 0);
+    for(size_t i = 0; i < count; i++)
+    {
+        long target = labelTarget(words[i], i, count);
+        if(target >= 0)
+        {
+            targets[target / 64] |= 1ull << (target % 64);
+
+        }
+
+    }
+
+    //second pass: the labels go in front of the words they mark
+    DisassembleResult result = disassembleWords(words, count, threads, &targets, timing);
+
+    //a label at the end of code goes after the last instruction
+    if(result.ok && (targets[count / 64] >> (count % 64)) & 1)
+    {
+        writeLabel(count, result.text);
+
+    }
+
+    return result;
+
+}
+
+DisassembleResult disassembleLabeled(const std::vector<uint32_t>& words, int threads, bool timing)
+{
+    return disassembleLabeled(words.data(), words.size(), threads, timing);
+
+}
+
+DisassembleResult disassembleWords(const uint32_t* words, size_t count, int threads, const std::vector<uint64_t>* targets, bool timing)
+{
+    if(threads > 1 && count > 1)
+    {
+        return parallelDisassemble(words, count, threads, targets, timing);
+
+    }
+
+    DisassembleResult result;
+    result.ok = true;
+    result.badWord = -1;
+    result.stats = makeRunStats();
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(!disassembleAt(words, count, i, targets, result.text, result.stats, timing))
+        {
+            result.diagnostics.push_back(unsupportedWord(i, words[i]));
+            result.badWord = i;
+            result.ok = false;
+            break;
+
+        }
+
+    }
+
+    return result;
+
+}
+
+long labelTarget(uint32_t word, size_t index, size_t count)
+{
+    const Instruction& instr = getInstruction(word);
+
+    long target;
+    if(instr.type == Instruction::J)
+    {
+        uint32_t pc = 0x00400000 + index * 4;
+        int64_t address = ((pc + 4) & 0xf0000000) | ((word & 0x3ffffff) << 2);
+        target = address < 0x00400000 ? -1 : (address - 0x00400000) / 4;
+
+    }
+    else if(instr.type == Instruction::I && instr.flag == Instruction::Jump)
+    {
+        target = index + 1 + (int16_t)(word & 0xffff);
+
+    }
+    else
+    {
+        return -1;
+
+    }
+
+    if(target < 0 || (size_t)target > count)
+    {
+        return -1;
+
+    }
+
+    //the assembler takes 1 off a branch offset unless the label is on the branch itself, and
+    //adds 1 for a label at the end of code, so those two cases would not come back the same
+    if(instr.type == Instruction::I && ((size_t)target == index || ((size_t)target == count && index + 1 == count)))
+    {
+        return -1;
+
+    }
+
+    return target;
+
+}
+
+bool disassembleAt(const uint32_t* words, size_t count, size_t index, const std::vector<uint64_t>* targets, std::string& text, RunStats& stats, bool timing)
+{
+    if(targets == NULL)
+    {
+        return disassembleWord(words[index], text, stats, timing);
+
+    }
+
+    if(((*targets)[index / 64] >> (index % 64)) & 1)
+    {
+        writeLabel(index, text);
+
+    }
+
+    long target = labelTarget(words[index], index, count);
+    if(target < 0)
+    {
+        return disassembleWord(words[index], text, stats, timing);
+
+    }
+
+    const Instruction& instr = getInstruction(words[index]);
+    writeLabeledInstruction(instr, words[index], target, text);
+
+    stats.lines++;
+    if(instr.type == Instruction::I)
+        stats.iTypes++;
+    else
+        stats.jTypes++;
+
+    return true;
+
+}
+
+void writeLabel(size_t index, std::string& out)
+{
+    char label[16];
+    snprintf(label, sizeof(label), "L_%08x:\n", (uint32_t)(0x00400000 + index * 4));
+    out += label;
+
+}
+
+void writeLabeledInstruction(const Instruction& instr, uint32_t word, size_t target, std::string& out)
+{
+    out += instr.opname;
+    out += " ";
+
+    //branches keep their registers, the offset or target becomes the label
+    if(instr.type == Instruction::I)
+    {
+        for(int i = 0; i < instr.regCount; i++)
+        {
+            Instruction::RegType t = instr.regOrder[i];
+            out += getRegName(t == Instruction::rs ? (word >> 21) & 0x1f : (word >> 16) & 0x1f);
+            out += ", ";
+
+        }
+
+    }
+
+    char label[16];
+    snprintf(label, sizeof(label), "L_%08x\n", (uint32_t)(0x00400000 + target * 4));
+    out += label;
+
+}
+
+//word aligned shards, a few per thread so one slow shard does not hold the others up.
+//each shard is formatted into its own buffer and the buffers are joined in order
+DisassembleResult parallelDisassemble(const uint32_t* words, size_t count, int threads, const std::vector<uint64_t>* targets, bool timing)
+{
+    size_t shardCount = std::min(count, (size_t)threads * 4);
+    size_t shardSize = (count + shardCount - 1) / shardCount;
+
+    std::vector<DisassemblyShard> shards((count + shardSize - 1) / shardSize);
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        shards[i].begin = i * shardSize;
+        shards[i].end = std::min(count, shards[i].begin + shardSize);
+        shards[i].badWord = -1;
+        shards[i].stats = makeRunStats();
+
+    }
+
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&shards, words, count, threads, targets, timing, t]()
+        {
+            for(size_t i = t; i < shards.size(); i += threads)
+            {
+                //most lines fit in this, it saves growing the buffer over and over
+                DisassemblyShard& shard = shards[i];
+                shard.text.reserve((shard.end - shard.begin) * 24);
+                for(size_t k = shard.begin; k < shard.end; k++)
+                {
+                    if(!disassembleAt(words, count, k, targets, shard.text, shard.stats, timing))
+                    {
+                        shard.badWord = k;
+                        break;
+
+                    }
+
+                }
+
+            }
+
+        }));
+
+    }
+
+    for(unsigned int t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+
+    }
+
+    //join up to and including the first shard that stopped early
+    DisassembleResult result;
+    result.ok = true;
+    result.badWord = -1;
+    result.stats = makeRunStats();
+
+    size_t size = 0;
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        size += shards[i].text.size();
+
+    }
+
+    //the first buffer is taken over whole when it has room for the rest
+    bool taken = shards[0].text.capacity() >= size;
+    if(taken)
+        result.text.swap(shards[0].text);
+    else
+        result.text.reserve(size);
+
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        DisassemblyShard& shard = shards[i];
+        if(i > 0 || !taken)
+        {
+            result.text += shard.text;
+
+        }
+
+        addRunStats(result.stats, shard.stats);
+        std::string().swap(shard.text);
+
+        if(shard.badWord >= 0)
+        {
+            result.diagnostics.push_back(unsupportedWord(shard.badWord, words[shard.badWord]));
+            result.badWord = shard.badWord;
+            result.ok = false;
+            break;
+
+        }
+
+    }
+
+    return result;
+
+}
+
+std::string unsupportedWord(size_t index, uint32_t word)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "word %zu is 0x%08x\n", index, word);
+    return "instruction not supported by this disassembler.\n" + std::string(text);
+
+}
+
+OutputFormat makeOutputFormat()
+{
+    OutputFormat format;
+    format.hex = false;
+    format.binary = true;
+    format.programCounter = false;
+    format.raw = false;
+    format.bigEndian = false;
+    format.elf = false;
+    return format;
+
+}
+
+void formatHeader(const OutputFormat& format, std::string& out)
+{
+    if(format.raw)
+    {
+        char header[4] = { 0x7f, 'D', 'V', format.bigEndian ? 'B' : 'L' };
+        out.append(header, 4);
+
+    }
+
+}
+
+constexpr TextTables makeTextTables()
+{
+    TextTables tables = {};
+    for(int i = 0; i < 256; i++)
+    {
+        for(int bit = 0; bit < 8; bit++)
+        {
+            tables.binary[i][bit] = (i >> (7 - bit)) & 1 ? '1' : '0';
+
+        }
+
+        tables.hex[i][0] = "0123456789abcdef"[i >> 4];
+        tables.hex[i][1] = "0123456789abcdef"[i & 0xf];
+
+    }
+
+    return tables;
+
+}
+
+constexpr TextTables textTables = makeTextTables();
+
+char* writeHex(uint32_t value, char* out)
+{
+    //"0x" and 8 digits, a byte at a time
+    out[0] = '0';
+    out[1] = 'x';
+    memcpy(out + 2, textTables.hex[value >> 24], 2);
+    memcpy(out + 4, textTables.hex[(value >> 16) & 0xff], 2);
+    memcpy(out + 6, textTables.hex[(value >> 8) & 0xff], 2);
+    memcpy(out + 8, textTables.hex[value & 0xff], 2);
+    return out + 10;
+
+}
+
+char* writeBinary(uint32_t value, char* out)
+{
+    memcpy(out, textTables.binary[value >> 24], 8);
+    memcpy(out + 8, textTables.binary[(value >> 16) & 0xff], 8);
+    memcpy(out + 16, textTables.binary[(value >> 8) & 0xff], 8);
+    memcpy(out + 24, textTables.binary[value & 0xff], 8);
+    return out + 32;
+
+}
+
+char* writeLine(const OutputFormat& format, uint32_t word, uint32_t pc, char* out)
+{
+    //raw images skip all the text formatting
+    if(format.raw)
+    {
+        for(unsigned int i = 0; i < 4; i++)
+        {
+            int shift = format.bigEndian ? 24 - i*8 : i*8;
+            *out++ = (char)((word >> shift) & 0xff);
+
+        }
+
+        return out;
+
+    }
+
+    if(format.programCounter)
+    {
+        out = writeHex(pc, out);
+        *out++ = '\t';
+
+    }
+
+    //output in hexadecimal format
+    if(format.hex)
+    {
+        out = writeHex(word, out);
+        if(format.binary)
+        {
+            *out++ = '\t';
+
+        }
+
+    }
+
+    if(format.binary)
+    {
+        out = writeBinary(word, out);
+
+    }
+
+    *out++ = '\n';
+    return out;
+
+}
+
+size_t formatSize(const OutputFormat& format, size_t count)
+{
+    if(format.raw)
+    {
+        return count * 4;
+
+    }
+
+    //every line is the same length
+    size_t line = 1;
+    line += format.programCounter ? 11 : 0;
+    line += format.hex ? (format.binary ? 11 : 10) : 0;
+    line += format.binary ? 32 : 0;
+    return count * line;
+
+}
+
+void formatWord(const OutputFormat& format, uint32_t word, int pc, std::string& out)
+{
+    size_t start = out.size();
+    out.resize(start + formatSize(format, 1));
+    writeLine(format, word, pc, &out[start]);
+
+}
+
+void formatWords(const OutputFormat& format, const uint32_t* words, size_t count, int pc, std::string& out)
+{
+    size_t start = out.size();
+    out.resize(start + formatSize(format, count));
+    formatWords(format, words, count, pc, &out[0] + start);
+
+}
+
+char* formatWords(const OutputFormat& format, const uint32_t* words, size_t count, int pc, char* out)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out = writeLine(format, words[i], pc, out);
+        pc += 0x000004;
+
+    }
+
+    return out;
+
+}
+
+void appendElf16(std::string& out, uint32_t value, bool bigEndian)
+{
+    char bytes[2] = { (char)value, (char)(value >> 8) };
+    if(bigEndian)
+        std::swap(bytes[0], bytes[1]);
+
+    out.append(bytes, 2);
+
+}
+
+void appendElf32(std::string& out, uint32_t value, bool bigEndian)
+{
+    char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+    if(bigEndian)
+    {
+        std::swap(bytes[0], bytes[3]);
+        std::swap(bytes[1], bytes[2]);
+
+    }
+
+    out.append(bytes, 4);
+
+}
+
+uint32_t readElf16(const char* data, bool bigEndian)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    return bigEndian ? (bytes[0] << 8) | bytes[1] : bytes[0] | (bytes[1] << 8);
+
+}
+
+uint32_t readElf32(const char* data, bool bigEndian)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    if(bigEndian)
+        return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+
+}
+
+void formatElf(const OutputFormat& format, const std::vector<uint32_t>& words, const std::vector<Label>& labels, std::string& out)
+{
+    bool big = format.bigEndian;
+
+    //headers, padding up to the page the segment starts on, .text, .symtab, .strtab,
+    //.shstrtab and the section headers last
+    const uint32_t textOffset = elfPageSize;
+    uint32_t textSize = words.size() * 4;
+
+    //symbol 0 is the null symbol, a label at the end of code points just past the last word
+    std::string names(1, '\0');
+    std::vector<uint32_t> nameOffsets;
+    std::vector<uint32_t> values;
+    uint32_t entry = 0x00400000;
+    for(unsigned int i = 0; i < labels.size(); i++)
+    {
+        const Label& label = labels[i];
+        if(!label.defined)
+        {
+            continue;
+
+        }
+
+        uint32_t value = label.address + (label.last ? 4 : 0);
+        if(label.name == "main")
+        {
+            entry = value;
+
+        }
+
+        nameOffsets.push_back(names.size());
+        values.push_back(value);
+        names += label.name;
+        names += '\0';
+
+    }
+
+    const char sectionNames[] = "\0.text\0.symtab\0.strtab\0.shstrtab";
+    uint32_t symtabOffset = textOffset + textSize;
+    uint32_t symtabSize = (values.size() + 1) * 16;
+    uint32_t strtabOffset = symtabOffset + symtabSize;
+    uint32_t shstrtabOffset = strtabOffset + names.size();
+    uint32_t sectionsOffset = (shstrtabOffset + sizeof(sectionNames) + 3) & ~3u;
+
+    out.reserve(out.size() + sectionsOffset + 5 * 40);
+    size_t start = out.size();
+
+    //elf header: 32 bit, byte order, version 1, an executable for mips32
+    const char ident[16] = { 0x7f, 'E', 'L', 'F', 1, (char)(big ? 2 : 1), 1 };
+    out.append(ident, 16);
+    appendElf16(out, 2, big);
+    appendElf16(out, 8, big);
+    appendElf32(out, 1, big);
+    appendElf32(out, entry, big);
+    appendElf32(out, 52, big);
+    appendElf32(out, sectionsOffset, big);
+    appendElf32(out, 0x50001000, big);
+    appendElf16(out, 52, big);
+    appendElf16(out, 32, big);
+    appendElf16(out, 1, big);
+    appendElf16(out, 40, big);
+    appendElf16(out, 5, big);
+    appendElf16(out, 4, big);
+
+    //one read/execute segment that is exactly .text, page aligned in the file so it can be mapped
+    appendElf32(out, 1, big);
+    appendElf32(out, textOffset, big);
+    appendElf32(out, 0x00400000, big);
+    appendElf32(out, 0x00400000, big);
+    appendElf32(out, textSize, big);
+    appendElf32(out, textSize, big);
+    appendElf32(out, 5, big);
+    appendElf32(out, elfPageSize, big);
+
+    out.resize(start + textOffset, '\0');
+
+    for(unsigned int i = 0; i < words.size(); i++)
+    {
+        appendElf32(out, words[i], big);
+
+    }
+
+    //every label is a global symbol in .text
+    out.append(16, '\0');
+    for(unsigned int i = 0; i < values.size(); i++)
+    {
+        appendElf32(out, nameOffsets[i], big);
+        appendElf32(out, values[i], big);
+        appendElf32(out, 0, big);
+        out += (char)0x10;
+        out += '\0';
+        appendElf16(out, 1, big);
+
+    }
+
+    out += names;
+    out.append(sectionNames, sizeof(sectionNames));
+    out.resize(start + sectionsOffset, '\0');
+
+    //name, type, flags, address, offset, size, link, info, alignment, entry size
+    const uint32_t sections[5][10] =
+    {
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 1, 1, 6, 0x00400000, textOffset, textSize, 0, 0, 4, 0 },
+        { 7, 2, 0, 0, symtabOffset, symtabSize, 3, 1, 4, 16 },
+        { 15, 3, 0, 0, strtabOffset, (uint32_t)names.size(), 0, 0, 1, 0 },
+        { 23, 3, 0, 0, shstrtabOffset, sizeof(sectionNames), 0, 0, 1, 0 }
+
+    };
+
+    for(int i = 0; i < 5; i++)
+    {
+        for(int k = 0; k < 10; k++)
+        {
+            appendElf32(out, sections[i][k], big);
+
+        }
+
+    }
+
+}
+
+ImageReader makeImageReader()
+{
+    ImageReader reader;
+    reader.format = ImageReader::Unknown;
+    reader.bigEndian = false;
+    reader.headerSize = 0;
+    reader.word = 0;
+    reader.count = 0;
+    reader.elfReady = false;
+    reader.entry = 0x00400000;
+    reader.offset = 0;
+    reader.textBegin = 0;
+    reader.textEnd = 0;
+    return reader;
+
+}
+
+bool readImage(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words, std::string& error)
+{
+    size_t i = 0;
+
+    if(reader.format == ImageReader::Elf)
+    {
+        return readElf(reader, data, size, words, error);
+
+    }
+
+    //raw and elf images are detected by their header, anything else has to be binary text
+    if(reader.format == ImageReader::Unknown && size > 0)
+    {
+        reader.format = data[0] == 0x7f ? ImageReader::Raw : ImageReader::Text;
+
+    }
+
+    if(reader.format == ImageReader::Raw)
+    {
+        //the header can be split across two pieces too
+        while(reader.headerSize < 4 && i < size)
+        {
+            reader.header[reader.headerSize++] = data[i++];
+            if(reader.headerSize == 4)
+            {
+                const char* header = reader.header;
+                if(memcmp(header, "\x7f" "ELF", 4) == 0)
+                {
+                    reader.format = ImageReader::Elf;
+                    reader.elfHeaders.assign(header, 4);
+                    return readElf(reader, data + i, size - i, words, error);
+
+                }
+
+                if(header[1] != 'D' || header[2] != 'V' || (header[3] != 'L' && header[3] != 'B'))
+                {
+                    error = "input is not a dova raw image\naborting\n";
+                    return false;
+
+                }
+
+                reader.bigEndian = header[3] == 'B';
+
+            }
+
+        }
+
+        readRawBytes(reader, data + i, size - i, words);
+        return true;
+
+    }
+
+    //picked once for the whole process
+    static const BitLineParser parseBitLines = pickBitLineParser();
+
+    //grow geometrically, callers keep the words across chunks and an exact reserve
+    //would copy everything read so far on every call
+    size_t needed = words.size() + size / 33 + 1;
+    if(needed > words.capacity())
+    {
+        words.reserve(std::max(needed, 2 * words.capacity()));
+
+    }
+
+    for(; i < size; i++)
+    {
+        //whole lines go through the fast parser, it stops at the first thing it does not expect
+        if(reader.count == 0)
+        {
+            i += parseBitLines(data + i, size - i, words);
+            if(i >= size)
+            {
+                break;
+
+            }
+
+        }
+
+        char c = data[i];
+
+        //whitespace between (or inside) 32 bit groups is skipped like getline did
+        if(c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v')
+        {
+            continue;
+
+        }
+
+        if(c != '0' && c != '1')
+        {
+            error = std::string("invalid character \'") + c + "\' in input, expected binary\naborting\n";
+            return false;
+
+        }
+
+        reader.word = (reader.word << 1) | (c - '0');
+        reader.count++;
+
+        //a full instruction has been read
+        if(reader.count == 32)
+        {
+            words.push_back(reader.word);
+            reader.word = 0;
+            reader.count = 0;
+
+        }
+
+    }
+
+    return true;
+
+}
+
+void readRawBytes(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words)
+{
+    //bytes of a word can be split across two pieces
+    for(size_t i = 0; i < size; i++)
+    {
+        uint32_t byte = (unsigned char)data[i];
+        if(reader.bigEndian)
+            reader.word = (reader.word << 8) | byte;
+        else
+            reader.word |= byte << (reader.count * 8);
+
+        reader.count++;
+
+        if(reader.count == 4)
+        {
+            words.push_back(reader.word);
+            reader.word = 0;
+            reader.count = 0;
+
+        }
+
+    }
+
+}
+
+bool readElfHeaders(ImageReader& reader, std::string& error)
+{
+    const std::string& headers = reader.elfHeaders;
+    if(headers.size() < 52)
+    {
+        return true;
+
+    }
+
+    const char* h = headers.data();
+    if(h[4] != 1 || (h[5] != 1 && h[5] != 2))
+    {
+        error = "input is not a 32 bit elf image\naborting\n";
+        return false;
+
+    }
+
+    bool big = h[5] == 2;
+    if(readElf16(h + 18, big) != 8)
+    {
+        error = "elf image is not for mips\naborting\n";
+        return false;
+
+    }
+
+    size_t phoff = readElf32(h + 28, big);
+    size_t phentsize = readElf16(h + 42, big);
+    size_t phnum = readElf16(h + 44, big);
+    size_t need = phoff + phentsize * phnum;
+    if(phentsize < 32 || need > elfHeaderLimit)
+    {
+        error = "elf image has no executable segment\naborting\n";
+        return false;
+
+    }
+
+    if(headers.size() < need)
+    {
+        return true;
+
+    }
+
+    //the first loadable segment marked executable holds the code
+    for(size_t i = 0; i < phnum; i++)
+    {
+        const char* p = h + phoff + i * phentsize;
+        if(readElf32(p, big) != 1 || (readElf32(p + 24, big) & 1) == 0)
+        {
+            continue;
+
+        }
+
+        uint32_t size = readElf32(p + 16, big);
+        if(size % 4 != 0)
+        {
+            error = "elf executable segment is not a whole number of instructions\naborting\n";
+            return false;
+
+        }
+
+        reader.bigEndian = big;
+        reader.entry = readElf32(h + 24, big);
+        reader.textBegin = readElf32(p + 4, big);
+        reader.textEnd = reader.textBegin + size;
+        reader.elfReady = true;
+        return true;
+
+    }
+
+    error = "elf image has no executable segment\naborting\n";
+    return false;
+
+}
+
+void readElfBytes(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words)
+{
+    //only the bytes inside the segment count, everything around it is skipped
+    size_t begin = reader.textBegin > reader.offset ? std::min(reader.textBegin - reader.offset, size) : 0;
+    size_t end = reader.textEnd > reader.offset ? std::min(reader.textEnd - reader.offset, size) : 0;
+    if(begin < end)
+    {
+        readRawBytes(reader, data + begin, end - begin, words);
+
+    }
+
+    reader.offset += size;
+
+}
+
+bool readElf(ImageReader& reader, const char* data, size_t size, std::vector<uint32_t>& words, std::string& error)
+{
+    //the headers are gathered first, they can be split across any number of pieces
+    size_t i = 0;
+    if(!reader.elfReady)
+    {
+        i = std::min(size, elfHeaderLimit - reader.elfHeaders.size());
+        reader.elfHeaders.append(data, i);
+
+        if(!readElfHeaders(reader, error))
+        {
+            return false;
+
+        }
+
+        if(!reader.elfReady)
+        {
+            return true;
+
+        }
+
+        //the segment could start inside what was gathered
+        reader.offset = 0;
+        readElfBytes(reader, reader.elfHeaders.data(), reader.elfHeaders.size(), words);
+        std::string().swap(reader.elfHeaders);
+
+    }
+
+    readElfBytes(reader, data + i, size - i, words);
+    return true;
+
+}
+
+BitLineParser pickBitLineParser()
+{
+#ifdef DOVA_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return parseBitLinesAvx2;
+
+    if(__builtin_cpu_supports("sse2"))
+        return parseBitLinesSse2;
+#endif
+
+    return parseBitLinesScalar;
+
+}
+
+size_t skipNewline(const char* data, size_t size, size_t i)
+{
+    if(i < size && data[i] == '\n')
+        return i + 1;
+
+    if(i + 1 < size && data[i] == '\r' && data[i+1] == '\n')
+        return i + 2;
+
+    return i;
+
+}
+
+size_t parseBitLinesScalar(const char* data, size_t size, std::vector<uint32_t>& words)
+{
+    size_t i = 0;
+    while(size - i >= 32)
+    {
+        uint32_t word = 0;
+        bool valid = true;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        //8 digits at a time, after the xor every byte has to be 0 or 1 and the
+        //multiply gathers the low bit of each byte into the top byte, first digit highest
+        for(int k = 0; k < 4; k++)
+        {
+            uint64_t digits;
+            memcpy(&digits, data + i + k * 8, 8);
+            digits ^= 0x3030303030303030ull;
+            valid = valid && (digits & 0xfefefefefefefefeull) == 0;
+            word = (word << 8) | (uint32_t)((digits * 0x8040201008040201ull) >> 56);
+
+        }
+#else
+        for(int k = 0; k < 32; k++)
+        {
+            unsigned int digit = (unsigned char)data[i + k] - '0';
+            valid = valid && digit <= 1;
+            word = (word << 1) | (digit & 1);
+
+        }
+#endif
+
+        if(!valid)
+        {
+            break;
+
+        }
+
+        words.push_back(word);
+        i = skipNewline(data, size, i + 32);
+
+    }
+
+    return i;
+
+}
+
+#ifdef DOVA_X86_SIMD
+__attribute__((target("sse2")))
+size_t parseBitLinesSse2(const char* data, size_t size, std::vector<uint32_t>& words)
+{
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i one = _mm_set1_epi8('1');
+
+    size_t i = 0;
+    while(size - i >= 32)
+    {
+        __m128i high = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i low = _mm_loadu_si128((const __m128i*)(data + i + 16));
+
+        //every byte has to be '0' or '1'
+        __m128i highOnes = _mm_cmpeq_epi8(high, one);
+        __m128i lowOnes = _mm_cmpeq_epi8(low, one);
+        __m128i valid = _mm_and_si128(_mm_or_si128(highOnes, _mm_cmpeq_epi8(high, zero)),
+                                      _mm_or_si128(lowOnes, _mm_cmpeq_epi8(low, zero)));
+        if(_mm_movemask_epi8(valid) != 0xffff)
+        {
+            break;
+
+        }
+
+        //the mask has the first digit in bit 0, no byte shuffle in sse2 so reverse the bits instead
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(highOnes) | ((uint32_t)_mm_movemask_epi8(lowOnes) << 16);
+        mask = __builtin_bswap32(mask);
+        mask = ((mask >> 4) & 0x0f0f0f0f) | ((mask & 0x0f0f0f0f) << 4);
+        mask = ((mask >> 2) & 0x33333333) | ((mask & 0x33333333) << 2);
+        mask = ((mask >> 1) & 0x55555555) | ((mask & 0x55555555) << 1);
+
+        words.push_back(mask);
+        i = skipNewline(data, size, i + 32);
+
+    }
+
+    return i;
+
+}
+
+__attribute__((target("avx2")))
+size_t parseBitLinesAvx2(const char* data, size_t size, std::vector<uint32_t>& words)
+{
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i one = _mm256_set1_epi8('1');
+
+    //reverses the bytes of each 128 bit lane, the lanes get swapped after
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    size_t i = 0;
+    while(size - i >= 32)
+    {
+        __m256i digits = _mm256_loadu_si256((const __m256i*)(data + i));
+
+        //every byte has to be '0' or '1'
+        __m256i ones = _mm256_cmpeq_epi8(digits, one);
+        __m256i valid = _mm256_or_si256(ones, _mm256_cmpeq_epi8(digits, zero));
+        if((uint32_t)_mm256_movemask_epi8(valid) != 0xffffffffu)
+        {
+            break;
+
+        }
+
+        //byte reverse so the first digit lands in bit 31 of the mask
+        ones = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(ones, reverse), 0x4e);
+
+        words.push_back((uint32_t)_mm256_movemask_epi8(ones));
+        i = skipNewline(data, size, i + 32);
+
+    }
+
+    return i;
+
+}
+#endif
+
+bool finishImage(const ImageReader& reader, std::string& error)
+{
+    if(reader.format == ImageReader::Elf && (!reader.elfReady || reader.offset < reader.textEnd))
+    {
+        error = "elf image ends before its executable segment does\naborting\n";
+        return false;
+
+    }
+
+    if(reader.format == ImageReader::Raw && reader.headerSize < 4)
+    {
+        error = "input is not a dova raw image\naborting\n";
+        return false;
+
+    }
+
+    if(reader.format == ImageReader::Raw && reader.count != 0)
+    {
+        error = "raw image ends in the middle of an instruction\naborting\n";
+        return false;
+
+    }
+
+    return true;
+
+}
+
+uint32_t operandBits(const Instruction& instr)
+{
+    if(instr.type == Instruction::J)
+    {
+        return 0x3ffffff;
+
+    }
+
+    uint32_t bits = 0;
+    for(int i = 0; i < instr.regCount; i++)
+    {
+        Instruction::RegType t = instr.regOrder[i];
+        if(t == Instruction::rs)
+            bits |= 0x1f << 21;
+        else if(t == Instruction::rt)
+            bits |= 0x1f << 16;
+        else if(t == Instruction::rd)
+            bits |= 0x1f << 11;
+
+    }
+
+    if(instr.type == Instruction::I)
+        bits |= 0xffff;
+    else if(instr.operands[instr.operandCount-1] == Instruction::Immediate)
+        bits |= 0x1f << 6; //shamt
+
+    return bits;
+
+}
+
+bool imageRoundTrip(const OutputFormat& format, const AssembleResult& assembled, std::vector<uint32_t>& words, std::string& error)
+{
+    std::string image;
+    if(format.elf)
+    {
+        formatElf(format, assembled.words, assembled.labels, image);
+
+    }
+    else
+    {
+        formatHeader(format, image);
+        formatWords(format, assembled.words.data(), assembled.words.size(), 0x00400000, image);
+
+    }
+
+    words.clear();
+    ImageReader reader = makeImageReader();
+    return readImage(reader, image.data(), image.size(), words, error) && finishImage(reader, error);
+
+}
+
+long firstDifference(const std::vector<uint32_t>& expected, const std::vector<uint32_t>& words)
+{
+    size_t count = std::min(expected.size(), words.size());
+    for(size_t i = 0; i < count; i++)
+    {
+        if(expected[i] != words[i])
+        {
+            return i;
+
+        }
+
+    }
+
+    return expected.size() == words.size() ? -1 : (long)count;
+
+}
+
+bool reassembles(const AssembleResult& assembled, const std::string& text, std::string_view pass, int threads, VerifyResult& result)
+{
+    AssembleResult again = assemble(text, threads);
+    if(!again.ok)
+    {
+        result.diagnostics.push_back("the " + std::string(pass) + " disassembly does not assemble:\n");
+        result.diagnostics.insert(result.diagnostics.end(), again.diagnostics.begin(), again.diagnostics.end());
+        return false;
+
+    }
+
+    long bad = firstDifference(assembled.words, again.words);
+    if(bad >= 0)
+    {
+        char text[128];
+        snprintf(text, sizeof(text), "word %ld is 0x%08x but comes back as 0x%08x\n", bad,
+                 (size_t)bad < assembled.words.size() ? assembled.words[bad] : 0,
+                 (size_t)bad < again.words.size() ? again.words[bad] : 0);
+        result.diagnostics.push_back("round trip through the " + std::string(pass) + " disassembly differs.\n" + text);
+        result.badWord = bad;
+        return false;
+
+    }
+
+    return true;
+
+}
+
+VerifyResult verifyRoundTrip(std::string_view source, int threads)
+{
+    VerifyResult result;
+    result.ok = false;
+    result.words = 0;
+    result.badWord = -1;
+
+    AssembleResult assembled = assemble(source, threads);
+    if(!assembled.ok)
+    {
+        result.diagnostics = assembled.diagnostics;
+        return result;
+
+    }
+
+    result.words = assembled.words.size();
+
+    //every way the words can be written out has to read back the same
+    std::vector<uint32_t> words;
+    for(int i = 0; i < 5; i++)
+    {
+        OutputFormat format = makeOutputFormat();
+        format.raw = i == 1 || i == 2;
+        format.elf = i == 3 || i == 4;
+        format.bigEndian = i == 2 || i == 4;
+
+        std::string error;
+        if(!imageRoundTrip(format, assembled, words, error))
+        {
+            result.diagnostics.push_back(error);
+            return result;
+
+        }
+
+        long bad = firstDifference(assembled.words, words);
+        if(bad >= 0)
+        {
+            static const char* names[5] = { "text", "raw", "big-endian raw", "elf", "big-endian elf" };
+            result.diagnostics.push_back(std::string("the ") + names[i] + " image does not read back the same from word " + std::to_string(bad) + "\n");
+            result.badWord = bad;
+            return result;
+
+        }
+
+    }
+
+    DisassembleResult plain = disassemble(assembled.words, threads);
+    if(!plain.ok)
+    {
+        result.diagnostics = plain.diagnostics;
+        result.badWord = plain.badWord;
+        return result;
+
+    }
+
+    if(!reassembles(assembled, plain.text, "plain", threads, result))
+    {
+        return result;
+
+    }
+
+    DisassembleResult labeled = disassembleLabeled(assembled.words, threads);
+    if(!labeled.ok)
+    {
+        result.diagnostics = labeled.diagnostics;
+        result.badWord = labeled.badWord;
+        return result;
+
+    }
+
+    result.ok = reassembles(assembled, labeled.text, "labeled", threads, result);
+    return result;
+
+}
+
+uint64_t nextRandom(uint64_t& state)
+{
+    //splitmix64, every thread steps its own state
+    state += 0x9e3779b97f4a7c15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+
+}
+
+bool checkWord(uint32_t word, std::string& text, SourceLine& source, std::string& failure)
+{
+    const Instruction& instr = getInstruction(word);
+    char hex[16];
+
+    if(instr.type == Instruction::Error)
+    {
+        //the decode tables have to agree with the instruction list
+        uint32_t opcode = word >> 26;
+        for(int i = 0; i < instructionCount; i++)
+        {
+            if((uint32_t)instructions[i].opcode == opcode && (opcode != 0 || (uint32_t)instructions[i].funct == (word & 0x3f)))
+            {
+                snprintf(hex, sizeof(hex), "0x%08x", word);
+                failure = std::string(hex) + " is " + std::string(instructions[i].opname) + " but does not decode\n";
+                return false;
+
+            }
+
+        }
+
+        return true;
+
+    }
+
+    //the opcode and funct are the same as the word's so only the operand fields are left to compare
+    int zeros[3] = { 0, 0, 0 };
+    uint32_t expected = encodeInstruction(instr, zeros, 0) | (word & operandBits(instr));
+
+    text.clear();
+    writeInstruction(instr, word, text);
+    std::string_view line(text.data(), text.size() - 1);
+
+    std::string error;
+    uint32_t again = 0;
+    std::string_view labelName;
+    RunStats stats = makeRunStats();
+    PhaseClock clock = startClock(false);
+
+    if(!splitLabel(line, source, error) || source.code >= source.count ||
+       !encodeLine(source, 1, line, again, labelName, error, stats, clock))
+    {
+        snprintf(hex, sizeof(hex), "0x%08x", word);
+        failure = std::string(hex) + " disassembles to \"" + std::string(line) + "\" which does not assemble:\n" + error;
+        return false;
+
+    }
+
+    if(again != expected || !labelName.empty())
+    {
+        char got[64];
+        snprintf(got, sizeof(got), "\" which assembles to 0x%08x instead of 0x%08x\n", again, expected);
+        snprintf(hex, sizeof(hex), "0x%08x", word);
+        failure = std::string(hex) + " disassembles to \"" + std::string(line) + got;
+        return false;
+
+    }
+
+    return true;
+
+}
+
+FuzzResult fuzz(unsigned long cases, uint64_t seed, int threads)
+{
+    if(threads < 1)
+    {
+        threads = 1;
+
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<unsigned long> failures(threads, 0);
+    std::vector<std::vector<std::string>> reports(threads);
+
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&failures, &reports, cases, seed, threads, t]()
+        {
+            //every case is picked by its own number so the split between threads does not matter
+            std::string text;
+            std::string failure;
+            SourceLine source;
+
+            for(unsigned long c = t; c < cases; c += threads)
+            {
+                uint64_t state = seed ^ (c * 0xd1b54a32d192ed03ull);
+                uint64_t r = nextRandom(state);
+                uint32_t word = (uint32_t)r;
+
+                //odd cases are built from an instruction so every one of them gets covered evenly
+                if(c & 1)
+                {
+                    const Instruction& instr = instructions[(r >> 32) % instructionCount];
+                    int zeros[3] = { 0, 0, 0 };
+                    word = encodeInstruction(instr, zeros, 0) | (word & operandBits(instr));
+
+                }
+
+                if(!checkWord(word, text, source, failure))
+                {
+                    failures[t]++;
+                    if(reports[t].size() < fuzzReportLimit)
+                    {
+                        reports[t].push_back("case " + std::to_string(c) + ": " + failure);
+
+                    }
+
+                }
+
+            }
+
+        }));
+
+    }
+
+    for(unsigned int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+
+    }
+
+    FuzzResult result;
+    result.cases = cases;
+    result.failures = 0;
+    for(int t = 0; t < threads; t++)
+    {
+        result.failures += failures[t];
+        for(unsigned int i = 0; i < reports[t].size() && result.diagnostics.size() < fuzzReportLimit; i++)
+        {
+            result.diagnostics.push_back(reports[t][i]);
+
+        }
+
+    }
+
+    result.ok = result.failures == 0;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+
+}
+
+SimMemory makeSimMemory()
+{
+    SimMemory memory;
+    for(int i = 0; i < 1024; i++)
+    {
+        memory.directory[i] = -1;
+
+    }
+
+    return memory;
+
+}
+
+uint32_t loadWord(const SimMemory& memory, uint32_t address)
+{
+    int table = memory.directory[address >> 22];
+    if(table < 0)
+    {
+        return 0;
+
+    }
+
+    int page = memory.tables[table * 1024 + ((address >> 12) & 1023)];
+    if(page < 0)
+    {
+        return 0;
+
+    }
+
+    return memory.pages[page * 1024 + ((address >> 2) & 1023)];
+
+}
+
+void storeWord(SimMemory& memory, uint32_t address, uint32_t value)
+{
+    int& table = memory.directory[address >> 22];
+    if(table < 0)
+    {
+        table = memory.tables.size() / 1024;
+        memory.tables.resize(memory.tables.size() + 1024, -1);
+
+    }
+
+    int& page = memory.tables[table * 1024 + ((address >> 12) & 1023)];
+    if(page < 0)
+    {
+        page = memory.pages.size() / 1024;
+        memory.pages.resize(memory.pages.size() + 1024, 0);
+
+    }
+
+    memory.pages[page * 1024 + ((address >> 2) & 1023)] = value;
+
+}
+
+SimOp decodeForRun(uint32_t word, int index)
+{
+    const Instruction& instr = getInstruction(word);
+
+    SimOp op;
+    op.code = SimOp::Invalid;
+    op.rs = (word >> 21) & 0x1f;
+    op.rt = (word >> 16) & 0x1f;
+    op.rd = (word >> 11) & 0x1f;
+    op.shamt = (word >> 6) & 0x1f;
+    op.imm = (int16_t)(word & 0xffff);
+
+    if(instr.type == Instruction::Error)
+    {
+        return op;
+
+    }
+
+    //writes to $zero go to a spare register nobody reads so the loop never has to check
+    if(op.rd == 0)
+        op.rd = 32;
+
+    if(instr.type == Instruction::R)
+    {
+        switch(instr.funct)
+        {
+            case 0x20: op.code = SimOp::Add; break;
+            case 0x22: op.code = SimOp::Sub; break;
+            case 0x24: op.code = SimOp::And; break;
+            case 0x25: op.code = SimOp::Or; break;
+            case 0x27: op.code = SimOp::Nor; break;
+            case 0x2a: op.code = SimOp::Slt; break;
+            case 0x00: op.code = SimOp::Sll; break;
+            case 0x02: op.code = SimOp::Srl; break;
+            case 0x08: op.code = SimOp::Jr; break;
+
+        }
+
+        return op;
+
+    }
+
+    //branches and jumps go straight to the index of the word they land on
+    if(instr.type == Instruction::J)
+    {
+        uint32_t pc = 0x00400000 + index * 4;
+        uint32_t target = ((pc + 4) & 0xf0000000) | ((word & 0x3ffffff) << 2);
+        op.code = instr.opcode == 0x3 ? SimOp::Jal : SimOp::J;
+        op.imm = ((int64_t)target - 0x00400000) / 4;
+        return op;
+
+    }
+
+    if(op.rt == 0 && instr.flag != Instruction::Jump && instr.opcode != 0x2b)
+        op.rt = 32;
+
+    switch(instr.opcode)
+    {
+        case 0x08: op.code = SimOp::Addi; break;
+        case 0x0c: op.code = SimOp::Andi; op.imm = word & 0xffff; break;
+        case 0x0d: op.code = SimOp::Ori; op.imm = word & 0xffff; break;
+        case 0x04: op.code = SimOp::Beq; op.imm += index + 1; break;
+        case 0x05: op.code = SimOp::Bne; op.imm += index + 1; break;
+        case 0x23: op.code = SimOp::Lw; break;
+        case 0x2b: op.code = SimOp::Sw; break;
+
+    }
+
+    return op;
+
+}
+
+std::string simFaultText(SimFault fault, uint32_t value, uint32_t pc, unsigned long maxSteps)
+{
+    char text[128];
+    switch(fault)
+    {
+        case Overflow: snprintf(text, sizeof(text), "arithmetic overflow at 0x%08x", pc); break;
+        case UnalignedJump: snprintf(text, sizeof(text), "jump to unaligned address 0x%08x at 0x%08x", value, pc); break;
+        case UnalignedAccess: snprintf(text, sizeof(text), "unaligned memory access to 0x%08x at 0x%08x", value, pc); break;
+        case Unsupported: snprintf(text, sizeof(text), "unsupported instruction 0x%08x at 0x%08x", value, pc); break;
+        default: snprintf(text, sizeof(text), "step limit of %lu instructions reached at 0x%08x", maxSteps, pc); break;
+
+    }
+
+    return std::string(text) + "\naborting\n";
+
+}
+
+SimResult simulate(const std::vector<uint32_t>& words, uint32_t entry, unsigned long maxSteps)
+{
+    SimResult result;
+    result.ok = false;
+    result.steps = 0;
+    result.seconds = 0.0;
+
+    //everything is decoded up front, the loop below only ever looks at these
+    int count = words.size();
+    std::vector<SimOp> code(count);
+    SimMemory memory = makeSimMemory();
+    for(int i = 0; i < count; i++)
+    {
+        code[i] = decodeForRun(words[i], i);
+        storeWord(memory, 0x00400000 + i * 4, words[i]);
+
+    }
+
+    //the usual spim stack and global pointers, $ra is 0 so returning from main ends the run
+    uint32_t r[33] = {};
+    r[28] = 0x10008000;
+    r[29] = 0x7fffeffc;
+
+    int i = ((int64_t)entry - 0x00400000) / 4;
+    unsigned long steps = 0;
+    SimFault fault = NoFault;
+    uint32_t faultValue = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while((unsigned int)i < (unsigned int)count && steps < maxSteps && fault == NoFault)
+    {
+        const SimOp& op = code[i];
+        steps++;
+
+        switch(op.code)
+        {
+            case SimOp::Add:
+            {
+                int32_t sum;
+                if(__builtin_add_overflow((int32_t)r[op.rs], (int32_t)r[op.rt], &sum))
+                {
+                    fault = Overflow;
+                    break;
+
+                }
+
+                r[op.rd] = sum;
+                i++;
+                break;
+
+            }
+            case SimOp::Sub:
+            {
+                int32_t difference;
+                if(__builtin_sub_overflow((int32_t)r[op.rs], (int32_t)r[op.rt], &difference))
+                {
+                    fault = Overflow;
+                    break;
+
+                }
+
+                r[op.rd] = difference;
+                i++;
+                break;
+
+            }
+            case SimOp::Addi:
+            {
+                int32_t sum;
+                if(__builtin_add_overflow((int32_t)r[op.rs], op.imm, &sum))
+                {
+                    fault = Overflow;
+                    break;
+
+                }
+
+                r[op.rt] = sum;
+                i++;
+                break;
+
+            }
+            case SimOp::And: r[op.rd] = r[op.rs] & r[op.rt]; i++; break;
+            case SimOp::Or: r[op.rd] = r[op.rs] | r[op.rt]; i++; break;
+            case SimOp::Nor: r[op.rd] = ~(r[op.rs] | r[op.rt]); i++; break;
+            case SimOp::Slt: r[op.rd] = (int32_t)r[op.rs] < (int32_t)r[op.rt]; i++; break;
+            case SimOp::Sll: r[op.rd] = r[op.rt] << op.shamt; i++; break;
+            case SimOp::Srl: r[op.rd] = r[op.rt] >> op.shamt; i++; break;
+            case SimOp::Andi: r[op.rt] = r[op.rs] & op.imm; i++; break;
+            case SimOp::Ori: r[op.rt] = r[op.rs] | op.imm; i++; break;
+            case SimOp::Beq: i = r[op.rs] == r[op.rt] ? op.imm : i + 1; break;
+            case SimOp::Bne: i = r[op.rs] != r[op.rt] ? op.imm : i + 1; break;
+            case SimOp::J: i = op.imm; break;
+            case SimOp::Jal: r[31] = 0x00400000 + (i + 1) * 4; i = op.imm; break;
+            case SimOp::Jr:
+            {
+                uint32_t target = r[op.rs];
+                if(target & 3)
+                {
+                    fault = UnalignedJump;
+                    faultValue = target;
+                    break;
+
+                }
+
+                //anywhere outside the code ends the run
+                i = ((int64_t)target - 0x00400000) / 4;
+                break;
+
+            }
+            case SimOp::Lw:
+            case SimOp::Sw:
+            {
+                uint32_t address = r[op.rs] + op.imm;
+                if(address & 3)
+                {
+                    fault = UnalignedAccess;
+                    faultValue = address;
+                    break;
+
+                }
+
+                if(op.code == SimOp::Lw)
+                    r[op.rt] = loadWord(memory, address);
+                else
+                    storeWord(memory, address, r[op.rt]);
+
+                i++;
+                break;
+
+            }
+            case SimOp::Invalid:
+            {
+                fault = Unsupported;
+                faultValue = words[i];
+                break;
+
+            }
+
+        }
+
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    //a faulting instruction is not retired
+    result.steps = fault == NoFault ? steps : steps - 1;
+    result.pc = 0x00400000 + (uint32_t)i * 4;
+    for(int k = 0; k < 32; k++)
+    {
+        result.regs[k] = r[k];
+
+    }
+
+    result.regs[0] = 0;
+
+    if(fault == NoFault && (unsigned int)i < (unsigned int)count)
+    {
+        fault = StepLimit;
+
+    }
+
+    if(fault != NoFault)
+    {
+        result.diagnostics.push_back(simFaultText(fault, faultValue, result.pc, maxSteps));
+
+    }
+    else
+    {
+        result.ok = true;
+
+    }
+
+    return result;
+
+}